@@ -1,6 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+// the vector kernels exist only on x86, other targets use the lookup table
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SHIFT 1
+#include <immintrin.h>
+#endif
 
 enum error_codes {
     ERROR_INPUT = 100, 
@@ -10,9 +21,113 @@ enum error_codes {
 enum const_values {
     STR_COUNT = 2,
     ROTATIONS_COUNT = 52,
-    INIT_SIZE = 100
+    INIT_SIZE = 100,
+    CHAR_VALUES = 256,
+    WORD_BITS = 64,
+    BAND_PER_WORD = 4,
+    VECTOR_SIZE = 32,
+    BATCH_BLOCK = 1 << 20,
+    BATCH_CHUNK = 1024,
+    CELLS_PER_THREAD = 1 << 16
+};
+
+enum char_classes {
+    CLASS_INVALID,
+    CLASS_LETTER,
+    CLASS_NEWLINE
 };
 
+/**
+ * @brief Buffers of one thread computing Levenshtein distances, sized once for the longest string
+ */
+typedef struct {
+    char *rotated;                  // the rotated copy of the cyphered string
+    int *rows;                      // the two rows of levenstein_banded()
+    uint64_t *peq;                  // CHAR_VALUES match masks per word of levenstein_blocked()
+    uint64_t *pv;                   // the vertical differences of levenstein_blocked(), one per word
+    uint64_t *mv;
+} workspace_t;
+
+/**
+ * @brief State shared by the threads scoring the rotations in Levenshtein mode
+ */
+typedef struct {
+    const char *cyphered_str;
+    int len;
+    const char *overheard_str;
+    int overheard_len;
+    int next_rotation;              // the next rotation to claim, accessed atomically
+    int best_res;                   // the smallest distance found so far, accessed atomically
+    int results[ROTATIONS_COUNT + 1];
+    int failed;                     // set when a thread could not allocate its buffers, accessed atomically
+    workspace_t *workspace;         // buffers of a single thread, or NULL
+} rotation_search_t;
+
+/**
+ * @brief One line pair of the batch mode, both strings point into the input arena
+ */
+typedef struct {
+    char *cyphered_str;
+    const char *overheard_str;
+    int len;
+    int overheard_len;
+    int code;                       // EXIT_SUCCESS, ERROR_INPUT or ERROR_RANGE
+} batch_pair_t;
+
+/**
+ * @brief State shared by the threads decoding the pairs of the batch mode
+ */
+typedef struct {
+    batch_pair_t *pairs;
+    size_t count;
+    size_t next_pair;               // the first pair of the next chunk to claim, accessed atomically
+    int levenstein;
+    int max_len;
+} batch_t;
+
+/**
+ * @brief Decodes a stream of cyphered and overheard line pairs from standard input, one result
+ *        line per pair; lines of an invalid pair are left empty
+ * 
+ * @param levenstein - 1 to compare with the Levenshtein metric, 0 for the Hamming metric
+ * @param threads - the number of decoding threads
+ * @return int - EXIT_SUCCESS, or the error code of the first invalid pair
+ */
+int run_batch(int levenstein, int threads);
+
+/**
+ * @brief Reads the whole standard input into one buffer with large read() calls
+ * 
+ * @param size - the number of bytes read
+ * @return char* - the buffer with one spare byte after the input, or NULL on failure
+ */
+char* read_input(size_t *size);
+
+/**
+ * @brief Splits the input into line pairs in place and validates them through a class table
+ * 
+ * @param input - the input, its newlines are replaced by '\0'
+ * @param size - the size of the input
+ * @param batch - the batch receiving the pairs
+ * @return int - EXIT_SUCCESS, or ERROR_INPUT if allocation fails
+ */
+int split_pairs(char *input, size_t size, batch_t *batch);
+
+/**
+ * @brief Thread body decoding chunks of BATCH_CHUNK pairs of a batch_t until none is left
+ * 
+ * @param arg - the shared batch_t
+ * @return void* - NULL
+ */
+void* decode_pairs(void *arg);
+
+/**
+ * @brief Returns the number of online processors
+ * 
+ * @return int - the number of processors, at least 1
+ */
+int online_cores(void);
+
 /**
  * @brief Reads a string from standard input and allocates memory for it
  * 
@@ -35,8 +150,63 @@ char* enlarge_string(char *str, int *curr_size);
  * @param cyphered_str - the cyphered string
  * @param overheard_str - the overheard string to compare against
  * @param compare - the comparison function to use (Hamming or Levenshtein)
+ * @return int - EXIT_SUCCESS, or ERROR_INPUT if allocation fails and the string is left as it is
  */
-void decypher(char *cyphered_str, const char *overheard_str, int (*compare)(const char *first_str, const char *second_str));
+int decypher(char *cyphered_str, const char *overheard_str, int (*compare)(const char *first_str, const char *second_str));
+
+/**
+ * @brief Finds the best shift for the Hamming metric in a single pass. Every position votes
+ *        for the number of rotations that makes its characters equal, the most voted one wins.
+ * 
+ * @param cyphered_str - the cyphered string
+ * @param overheard_str - the overheard string of the same length
+ * @param len - the length of the strings
+ * @return int - the number of rotations with the most similar positions, the smallest one on a tie,
+ *               or 0 if no rotation makes any position similar
+ */
+int best_hamming_offset(const char *cyphered_str, const char *overheard_str, int len);
+
+/**
+ * @brief Finds the best shift for the Levenshtein metric. Up to one thread per rotation claims
+ *        rotations in order, scores them on a private copy and lowers the shared best distance,
+ *        which is the cutoff of every later rotation.
+ * 
+ * @param cyphered_str - the cyphered string
+ * @param len - the length of the cyphered string
+ * @param overheard_str - the overheard string
+ * @param threads - the number of threads, at most ROTATIONS_COUNT
+ * @param workspace - buffers for strings of at least len characters used by a single thread,
+ *                    or NULL to allocate them once per thread
+ * @return int - the number of rotations with the smallest distance, the smallest one on a tie,
+ *               0 if no rotation gets below the length of the cyphered string,
+ *               or -1 if a thread could not allocate its buffers
+ */
+int best_levenstein_offset(const char *cyphered_str, int len, const char *overheard_str, int threads,
+                           workspace_t *workspace);
+
+/**
+ * @brief Allocates the buffers of one thread for strings of up to max_len characters
+ * 
+ * @param workspace - the buffers to allocate
+ * @param max_len - the length of the longest cyphered string
+ * @return int - EXIT_SUCCESS, or ERROR_INPUT if allocation fails
+ */
+int workspace_init(workspace_t *workspace, int max_len);
+
+/**
+ * @brief Frees the buffers allocated by workspace_init()
+ * 
+ * @param workspace - the buffers to free
+ */
+void workspace_free(workspace_t *workspace);
+
+/**
+ * @brief Thread body scoring rotations of a rotation_search_t until none is left
+ * 
+ * @param arg - the shared rotation_search_t
+ * @return void* - NULL
+ */
+void* score_rotations(void *arg);
 
 /**
  * @brief Compares two strings using the Hamming distance metric
@@ -48,16 +218,86 @@ void decypher(char *cyphered_str, const char *overheard_str, int (*compare)(cons
 int compare_hamming(const char *first_str, const char *second_str);
 
 /**
- * @brief Compares two strings using the Levenshtein distance metric
+ * @brief Compares two strings using the Levenshtein distance metric. The shorter string is
+ *        the pattern whose column of the distance matrix is kept in bit vectors (Myers, 1999).
  * 
  * @param first_str - the first string
  * @param second_str - the second string
- * @return int - the Levenshtein distance between the two strings
+ * @return int - the Levenshtein distance between the two strings, or -1 if allocation fails
  */
 int compare_levenstein(const char *first_str, const char *second_str);
 
 /**
- * @brief Shifts each character in the string by the given offset
+ * @brief Computes the Levenshtein distance when it is at most max_dist. A narrow bound is
+ *        checked on a band of the matrix, a wide one by the bit-parallel kernels; both stop
+ *        as soon as the distance cannot stay within the bound.
+ * 
+ * @param first_str - the first string
+ * @param l1 - the length of the first string
+ * @param second_str - the second string
+ * @param l2 - the length of the second string
+ * @param max_dist - the largest distance of interest
+ * @param workspace - buffers for strings at least as long as the shorter one
+ * @return int - the Levenshtein distance if it is at most max_dist, max_dist + 1 otherwise
+ */
+int levenstein_within(const char *first_str, int l1, const char *second_str, int l2, int max_dist,
+                      const workspace_t *workspace);
+
+/**
+ * @brief Computes the bounded Levenshtein distance on the band of diagonals within max_dist of
+ *        the main one, keeping two rows along the shorter string
+ * 
+ * @param pattern - the shorter string
+ * @param m - the length of the pattern
+ * @param text - the longer string
+ * @param n - the length of the text
+ * @param max_dist - the largest distance of interest
+ * @param rows - room for 2 * (m + 1) cells
+ * @return int - as levenstein_within()
+ */
+int levenstein_banded(const char *pattern, int m, const char *text, int n, int max_dist, int *rows);
+
+/**
+ * @brief Computes the bounded Levenshtein distance of a pattern of at most WORD_BITS characters
+ * 
+ * @param pattern - the pattern, 1 to WORD_BITS characters long
+ * @param m - the length of the pattern
+ * @param text - the text
+ * @param n - the length of the text
+ * @param max_dist - the largest distance of interest
+ * @return int - as levenstein_within()
+ */
+int levenstein_word(const char *pattern, int m, const char *text, int n, int max_dist);
+
+/**
+ * @brief Computes the bounded Levenshtein distance of a long pattern split into blocks of WORD_BITS
+ *        rows, the horizontal difference at the bottom of each block is carried into the next one
+ * 
+ * @param pattern - the pattern
+ * @param m - the length of the pattern
+ * @param text - the text
+ * @param n - the length of the text
+ * @param max_dist - the largest distance of interest
+ * @param workspace - buffers for patterns of at least m characters
+ * @return int - as levenstein_within()
+ */
+int levenstein_blocked(const char *pattern, int m, const char *text, int n, int max_dist,
+                       const workspace_t *workspace);
+
+/**
+ * @brief Advances one block of the bit-vector column by one text character
+ * 
+ * @param pv - positive vertical differences of the block, updated
+ * @param mv - negative vertical differences of the block, updated
+ * @param eq - rows of the block whose pattern character equals the text character
+ * @param h_in - the horizontal difference entering the top of the block (-1, 0 or 1)
+ * @param last - the bit of the row whose horizontal difference is returned
+ * @return int - the horizontal difference leaving the block at row last
+ */
+int advance_block(uint64_t *pv, uint64_t *mv, uint64_t eq, int h_in, uint64_t last);
+
+/**
+ * @brief Shifts each character in the string by the given offset in one pass
  * 
  * @param str - the string to be shifted
  * @param offset - the number of rotations to shift each character
@@ -66,12 +306,40 @@ int compare_levenstein(const char *first_str, const char *second_str);
 void shift(char *str, int offset, int len);
 
 /**
- * @brief Rotates a character to the next character in the alphabet. Wraps 'z' to 'A' and 'Z' to 'a'
+ * @brief Writes the string shifted by the given offset to dst, with AVX2 when the CPU has it and
+ *        through a lookup table otherwise; characters other than letters are kept
+ * 
+ * @param dst - the destination of len characters, may be the same as src
+ * @param src - the string to be shifted
+ * @param offset - the number of rotations, 0 to ROTATIONS_COUNT
+ * @param len - the length of the string
+ */
+void shift_into(char *dst, const char *src, int offset, int len);
+
+/**
+ * @brief Checks whether all characters are letters, VECTOR_SIZE characters at a time with AVX2
+ * 
+ * @param str - the characters
+ * @param len - the number of characters
+ * @return int - 1 if all characters are letters, 0 otherwise
+ */
+int all_letters(const char *str, int len);
+
+/**
+ * @brief Fills a table mapping every character to its letter rotated offset times, other characters are kept
+ * 
+ * @param table - the table with CHAR_VALUES entries
+ * @param offset - the number of rotations
+ */
+void fill_shift_table(char *table, int offset);
+
+/**
+ * @brief Returns the position of a letter in the rotation order 'a' to 'z' followed by 'A' to 'Z'
  * 
- * @param original - the original character
- * @return char - the rotated character
+ * @param letter - the letter
+ * @return int - the position from 0 to ROTATIONS_COUNT - 1
  */
-char rotate(char original);
+int letter_position(char letter);
 
 /**
  * @brief Frees memory allocated for two strings
@@ -89,6 +357,36 @@ void handle_free(char *first_str, char *second_str);
 void handle_error(int code);
 
 int main(int argc, char *argv[]) {
+    int batch = 0;
+    int threads = 1;
+    int threads_set = 0;
+    int other_args = 0;
+
+    // a single argument besides the batch options selects Levenshtein in both modes
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threads = atoi(argv[i] + 10);
+            threads_set = 1;
+
+        } else {
+            ++other_args;
+        }
+    }
+
+    int levenstein = other_args == 1;
+
+    if (threads_set && !batch) {
+        fprintf(stderr, "Error: Prepinac --threads plati jen s --batch!\n");
+        return ERROR_INPUT;
+    }
+
+    if (batch) {
+        return run_batch(levenstein, threads > 1 ? threads : 1);
+    }
+
     int ret_code = EXIT_SUCCESS;
     char *strings[STR_COUNT] = { NULL, NULL };
 
@@ -100,14 +398,17 @@ int main(int argc, char *argv[]) {
     if (strings[0] == NULL || strings[1] == NULL) {
         ret_code = ERROR_INPUT;
 
-    } else if (strlen(strings[0]) != strlen(strings[1]) && argc != 2) {
+    } else if (strlen(strings[0]) != strlen(strings[1]) && !levenstein) {
         ret_code = ERROR_RANGE;
 
     } else {
         int (*compare_func)(const char *first_str, const char *second_str);
-        compare_func = argc == 2 ? compare_levenstein : compare_hamming;
-        decypher(strings[0], strings[1], compare_func);
-        printf("%s\n", strings[0]);
+        compare_func = levenstein ? compare_levenstein : compare_hamming;
+        ret_code = decypher(strings[0], strings[1], compare_func);
+
+        if (ret_code == EXIT_SUCCESS) {
+            printf("%s\n", strings[0]);
+        }
     }
 
     handle_free(strings[0], strings[1]);
@@ -142,12 +443,6 @@ char* read_string() {
     int char_count = 0;
 
     while ((c = getchar()) != '\n' && c != EOF) {
-        if (c < 'A' || (c > 'Z' && c < 'a') || c > 'z') {
-            free(str);
-            str = NULL;
-            break;
-        }
-
         str[char_count++] = c;
 
         if (char_count == str_size) { // the string is full
@@ -159,6 +454,12 @@ char* read_string() {
         }
     }
 
+    // the whole line is checked at once
+    if (str != NULL && !all_letters(str, char_count)) {
+        free(str);
+        str = NULL;
+    }
+
     if (str != NULL) {
         str[char_count] = '\0';
     }
@@ -166,25 +467,6 @@ char* read_string() {
     return str;
 }
 
-char rotate(char original) {
-    char rotated;
-
-    switch (original) {
-        case 'z':
-            original = 'A';
-            break;
-        case 'Z':
-            original = 'a';
-            break;
-        default:
-            ++original;
-            break;
-    } 
-
-    rotated = original;
-    return rotated;
-}
-
 int compare_hamming(const char *first_str, const char *second_str) {
     unsigned int len = strlen(first_str);
     int overlap = 0;
@@ -199,84 +481,699 @@ int compare_hamming(const char *first_str, const char *second_str) {
 }
 
 int compare_levenstein(const char *first_str, const char *second_str) {
-    unsigned int l1 = strlen(first_str) + 1;
-    unsigned int l2 = strlen(second_str) + 1;
+    int l1 = strlen(first_str);
+    int l2 = strlen(second_str);
 
-    int (*matrix)[l2] = malloc(sizeof(int[l1][l2]));
-    int sub_cost;
+    workspace_t workspace;
+    if (workspace_init(&workspace, l1 < l2 ? l1 : l2) != EXIT_SUCCESS) {
+        return -1;
+    }
 
-    for (int i = 0; i < l1; ++i) {
-        for (int j = 0; j < l2; ++j) {
-            matrix[i][j] = 0;
-        }
+    // the distance never exceeds the longer length
+    int dist = levenstein_within(first_str, l1, second_str, l2, l1 > l2 ? l1 : l2, &workspace);
+
+    workspace_free(&workspace);
+    return dist;
+}
+
+int workspace_init(workspace_t *workspace, int max_len) {
+    int words = (max_len + WORD_BITS - 1) / WORD_BITS;
+
+    workspace->rotated = (char *) malloc(max_len + 1);
+    workspace->rows = (int *) malloc(sizeof(int) * 2 * (max_len + 1));
+    workspace->peq = (uint64_t *) malloc(sizeof(uint64_t) * CHAR_VALUES * (words + 1));
+    workspace->pv = (uint64_t *) malloc(sizeof(uint64_t) * (words + 1));
+    workspace->mv = (uint64_t *) malloc(sizeof(uint64_t) * (words + 1));
+
+    if (workspace->rotated == NULL || workspace->rows == NULL || workspace->peq == NULL
+        || workspace->pv == NULL || workspace->mv == NULL) {
+        workspace_free(workspace);
+        return ERROR_INPUT;
     }
- 
-    for (int i = 1; i < l1; ++i) {
-        matrix[i][0] = i;
+
+    return EXIT_SUCCESS;
+}
+
+void workspace_free(workspace_t *workspace) {
+    free(workspace->rotated);
+    free(workspace->rows);
+    free(workspace->peq);
+    free(workspace->pv);
+    free(workspace->mv);
+    workspace->rotated = NULL;
+    workspace->rows = NULL;
+    workspace->peq = NULL;
+    workspace->pv = NULL;
+    workspace->mv = NULL;
+}
+
+int levenstein_within(const char *first_str, int l1, const char *second_str, int l2, int max_dist,
+                      const workspace_t *workspace) {
+    // the distance is symmetric, fewer rows mean fewer words per column
+    const char *pattern = l1 <= l2 ? first_str : second_str;
+    const char *text = l1 <= l2 ? second_str : first_str;
+    int m = l1 <= l2 ? l1 : l2;
+    int n = l1 <= l2 ? l2 : l1;
+
+    // at least the difference of the lengths has to be inserted
+    if (n - m > max_dist) {
+        return max_dist + 1;
     }
- 
-    for (int j = 1; j < l2; ++j) {
-        matrix[0][j] = j;
+
+    if (m == 0) {
+        return n;
     }
- 
-    for (int j = 1; j < l2; ++j) {
-        for (int i = 1; i < l1; ++i) {
-            if (first_str[i - 1] == second_str[j - 1]) {
-                sub_cost = 0;
 
-            } else {
-                sub_cost = 1;
-            }
- 
-            if (matrix[i - 1][j] + 1 < matrix[i][j - 1] + 1 
-                && matrix[i - 1][j] + 1 < matrix[i - 1][j - 1] + sub_cost) {
-                matrix[i][j] = matrix[i - 1][j] + 1;
+    int words = (m + WORD_BITS - 1) / WORD_BITS;
 
-            }  else if (matrix[i][j - 1] + 1 < matrix[i - 1][j - 1] + sub_cost) {
-                matrix[i][j] = matrix[i][j - 1] + 1;
+    if (2 * max_dist + 1 < BAND_PER_WORD * words) {
+        return levenstein_banded(pattern, m, text, n, max_dist, workspace->rows);
+    }
 
-            } else {
-                matrix[i][j] = (matrix[i - 1][j - 1] + sub_cost);
+    return m <= WORD_BITS ? levenstein_word(pattern, m, text, n, max_dist)
+                          : levenstein_blocked(pattern, m, text, n, max_dist, workspace);
+}
+
+int levenstein_banded(const char *pattern, int m, const char *text, int n, int max_dist, int *rows) {
+    int *prev = rows;
+    int *curr = rows + m + 1;
+
+    // every cell beyond max_dist is stored as max_dist + 1, so the cells outside the band are too
+    int over = max_dist + 1;
+
+    for (int j = 0; j <= m; ++j) {
+        prev[j] = j < over ? j : over;
+    }
+
+    for (int i = 1; i <= n; ++i) {
+        int lo = i - max_dist > 1 ? i - max_dist : 1;
+        int hi = i + max_dist < m ? i + max_dist : m;
+
+        curr[lo - 1] = lo == 1 && i < over ? i : over;
+        int row_min = curr[lo - 1];
+
+        for (int j = lo; j <= hi; ++j) {
+            int cell = prev[j - 1] + (text[i - 1] != pattern[j - 1]);
+
+            if (prev[j] + 1 < cell) {
+                cell = prev[j] + 1;
+            }
+
+            if (curr[j - 1] + 1 < cell) {
+                cell = curr[j - 1] + 1;
             }
+
+            curr[j] = cell < over ? cell : over;
+            row_min = curr[j] < row_min ? curr[j] : row_min;
+        }
+
+        if (hi < m) {
+            curr[hi + 1] = over;
+        }
+
+        // every path to the last cell crosses this row
+        if (row_min >= over) {
+            return over;
+        }
+
+        int *temp = prev;
+        prev = curr;
+        curr = temp;
+    }
+
+    return prev[m];
+}
+
+int advance_block(uint64_t *pv, uint64_t *mv, uint64_t eq, int h_in, uint64_t last) {
+    uint64_t h_neg = h_in < 0;
+    uint64_t xv = eq | *mv;
+
+    eq |= h_neg;
+    uint64_t xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+    uint64_t ph = *mv | ~(xh | *pv);
+    uint64_t mh = *pv & xh;
+
+    int h_out = (ph & last) ? 1 : ((mh & last) ? -1 : 0);
+
+    ph = (ph << 1) | (uint64_t) (h_in > 0);
+    mh = (mh << 1) | h_neg;
+
+    *pv = mh | ~(xv | ph);
+    *mv = ph & xv;
+
+    return h_out;
+}
+
+int levenstein_word(const char *pattern, int m, const char *text, int n, int max_dist) {
+    uint64_t peq[CHAR_VALUES];
+
+    // only the entries read below are cleared, short strings touch far fewer than all of them
+    for (int j = 0; j < n; ++j) {
+        peq[(unsigned char) text[j]] = 0;
+    }
+
+    for (int i = 0; i < m; ++i) {
+        peq[(unsigned char) pattern[i]] = 0;
+    }
+
+    for (int i = 0; i < m; ++i) {
+        peq[(unsigned char) pattern[i]] |= (uint64_t) 1 << i;
+    }
+
+    // the first column is 0..m, every vertical difference is +1
+    uint64_t pv = ~(uint64_t) 0;
+    uint64_t mv = 0;
+    uint64_t last = (uint64_t) 1 << (m - 1);
+    int dist = m;
+
+    // the first row is 0..n, so +1 enters the top of every column
+    for (int j = 0; j < n; ++j) {
+        dist += advance_block(&pv, &mv, peq[(unsigned char) text[j]], 1, last);
+
+        // each remaining column lowers the distance by one at most
+        if (dist - (n - 1 - j) > max_dist) {
+            return max_dist + 1;
+        }
+    }
+
+    return dist;
+}
+
+int levenstein_blocked(const char *pattern, int m, const char *text, int n, int max_dist,
+                       const workspace_t *workspace) {
+    int words = (m + WORD_BITS - 1) / WORD_BITS;
+    uint64_t *peq = workspace->peq;
+    uint64_t *pv = workspace->pv;
+    uint64_t *mv = workspace->mv;
+
+    // only the masks read below are cleared, as in levenstein_word()
+    for (int j = 0; j < n; ++j) {
+        memset(peq + (unsigned char) text[j] * words, 0, sizeof(uint64_t) * words);
+    }
+
+    for (int i = 0; i < m; ++i) {
+        memset(peq + (unsigned char) pattern[i] * words, 0, sizeof(uint64_t) * words);
+    }
+
+    for (int i = 0; i < m; ++i) {
+        peq[(unsigned char) pattern[i] * words + i / WORD_BITS] |= (uint64_t) 1 << (i % WORD_BITS);
+    }
+
+    for (int b = 0; b < words; ++b) {
+        pv[b] = ~(uint64_t) 0;
+        mv[b] = 0;
+    }
+
+    // rows past the end of the pattern in the last block only affect rows below it
+    uint64_t high = (uint64_t) 1 << (WORD_BITS - 1);
+    uint64_t last = (uint64_t) 1 << ((m - 1) % WORD_BITS);
+    int dist = m;
+
+    for (int j = 0; j < n; ++j) {
+        const uint64_t *eq = peq + (unsigned char) text[j] * words;
+        int h = 1;
+
+        for (int b = 0; b < words; ++b) {
+            h = advance_block(&pv[b], &mv[b], eq[b], h, b == words - 1 ? last : high);
+        }
+
+        dist += h;
+
+        if (dist - (n - 1 - j) > max_dist) {
+            return max_dist + 1;
         }
     }
-    
-    int lev_dist = matrix[l1 - 1][l2 - 1];
-    free(matrix);
 
-    return lev_dist;
+    return dist;
+}
+
+int letter_position(char letter) {
+    return letter >= 'a' ? letter - 'a' : letter - 'A' + ROTATIONS_COUNT / 2;
+}
+
+void fill_shift_table(char *table, int offset) {
+    for (int c = 0; c < CHAR_VALUES; ++c) {
+        table[c] = (char) c;
+    }
+
+    for (int pos = 0; pos < ROTATIONS_COUNT; ++pos) {
+        int half = ROTATIONS_COUNT / 2;
+        int target = (pos + offset) % ROTATIONS_COUNT;
+
+        char letter = pos < half ? 'a' + pos : 'A' + pos - half;
+        table[(unsigned char) letter] = target < half ? 'a' + target : 'A' + target - half;
+    }
 }
 
 void shift(char *str, int offset, int len) {
-    for (int i = 0; i < offset; ++i) {
-        for (int j = 0; j < len; ++j) {
-            str[j] = rotate(str[j]);
+    shift_into(str, str, offset, len);
+}
+
+#ifdef SIMD_SHIFT
+/**
+ * @brief Shifts the letters of a vector, positions in the rotation order wrap around ROTATIONS_COUNT
+ */
+__attribute__((target("avx2")))
+static inline __m256i shift_vector(__m256i chars, __m256i offset) {
+    __m256i folded = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+    __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1)),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), folded));
+    __m256i lower = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('a' - 1));
+
+    // 'a' to 'z' are positions 0 to 25, 'A' to 'Z' follow them
+    __m256i upper_base = _mm256_set1_epi8('A' - ROTATIONS_COUNT / 2);
+    __m256i case_gap = _mm256_set1_epi8('a' - 'A' + ROTATIONS_COUNT / 2);
+    __m256i pos = _mm256_sub_epi8(_mm256_sub_epi8(chars, upper_base), _mm256_and_si256(lower, case_gap));
+
+    pos = _mm256_add_epi8(pos, offset);
+    __m256i wrapped = _mm256_cmpgt_epi8(pos, _mm256_set1_epi8(ROTATIONS_COUNT - 1));
+    pos = _mm256_sub_epi8(pos, _mm256_and_si256(wrapped, _mm256_set1_epi8(ROTATIONS_COUNT)));
+
+    __m256i to_lower = _mm256_cmpgt_epi8(_mm256_set1_epi8(ROTATIONS_COUNT / 2), pos);
+    __m256i shifted = _mm256_add_epi8(_mm256_add_epi8(pos, upper_base), _mm256_and_si256(to_lower, case_gap));
+
+    return _mm256_blendv_epi8(chars, shifted, letters);
+}
+
+/**
+ * @brief AVX2 version of shift_into(), the tail is padded to a whole vector
+ */
+__attribute__((target("avx2")))
+static void shift_avx2(char *dst, const char *src, int offset, int len) {
+    __m256i vector_offset = _mm256_set1_epi8((char) (offset % ROTATIONS_COUNT));
+    int j = 0;
+
+    for (; j + VECTOR_SIZE <= len; j += VECTOR_SIZE) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *) (src + j));
+        _mm256_storeu_si256((__m256i *) (dst + j), shift_vector(chars, vector_offset));
+    }
+
+    if (j < len) {
+        char tail[VECTOR_SIZE] = { 0 };
+        memcpy(tail, src + j, len - j);
+
+        __m256i chars = _mm256_loadu_si256((const __m256i *) tail);
+        _mm256_storeu_si256((__m256i *) tail, shift_vector(chars, vector_offset));
+        memcpy(dst + j, tail, len - j);
+    }
+}
+
+/**
+ * @brief AVX2 version of all_letters()
+ */
+__attribute__((target("avx2")))
+static int all_letters_avx2(const char *str, int len) {
+    __m256i invalid = _mm256_setzero_si256();
+    int j = 0;
+
+    for (; j + VECTOR_SIZE <= len; j += VECTOR_SIZE) {
+        __m256i folded = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (str + j)), _mm256_set1_epi8(0x20));
+        __m256i letters = _mm256_and_si256(_mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), folded));
+        invalid = _mm256_or_si256(invalid, _mm256_xor_si256(letters, _mm256_set1_epi8(-1)));
+    }
+
+    if (_mm256_movemask_epi8(invalid) != 0) {
+        return 0;
+    }
+
+    for (; j < len; ++j) {
+        char folded = str[j] | 0x20;
+        if (folded < 'a' || folded > 'z') {
+            return 0;
         }
     }
+
+    return 1;
 }
+#endif
 
-void decypher(char *cyphered_str, const char *overheard_str, int (*compare)(const char *first_str, const char *second_str)) {
-    unsigned int len = strlen(cyphered_str);
-    int best_res = compare == compare_hamming ? 0 : len;
+void shift_into(char *dst, const char *src, int offset, int len) {
+#ifdef SIMD_SHIFT
+    if (__builtin_cpu_supports("avx2")) {
+        shift_avx2(dst, src, offset, len);
+        return;
+    }
+#endif
+
+    char table[CHAR_VALUES];
+    fill_shift_table(table, offset);
+
+    for (int j = 0; j < len; ++j) {
+        dst[j] = table[(unsigned char) src[j]];
+    }
+}
+
+int all_letters(const char *str, int len) {
+#ifdef SIMD_SHIFT
+    if (__builtin_cpu_supports("avx2")) {
+        return all_letters_avx2(str, len);
+    }
+#endif
+
+    // setting 0x20 maps 'A' to 'Z' onto 'a' to 'z' and nothing else into that range
+    for (int j = 0; j < len; ++j) {
+        char folded = str[j] | 0x20;
+        if (folded < 'a' || folded > 'z') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int best_hamming_offset(const char *cyphered_str, const char *overheard_str, int len) {
+    int votes[ROTATIONS_COUNT] = { 0 };
+
+    for (int j = 0; j < len; ++j) {
+        int needed = letter_position(overheard_str[j]) - letter_position(cyphered_str[j]);
+        ++votes[needed < 0 ? needed + ROTATIONS_COUNT : needed];
+    }
+
+    // rotations are tried from 1, the full turn of ROTATIONS_COUNT counts as no rotation
+    int best_res = 0;
+    int offset = 0;
+
+    for (int i = 1; i <= ROTATIONS_COUNT; ++i) {
+        if (votes[i % ROTATIONS_COUNT] > best_res) {
+            best_res = votes[i % ROTATIONS_COUNT];
+            offset = i;
+        }
+    }
+
+    return offset;
+}
+
+void* score_rotations(void *arg) {
+    rotation_search_t *search = (rotation_search_t *) arg;
+
+    // each thread allocates its buffers once for all the rotations it claims
+    workspace_t own = { NULL, NULL, NULL, NULL, NULL };
+    workspace_t *workspace = search->workspace;
+
+    if (workspace == NULL && workspace_init(&own, search->len) == EXIT_SUCCESS) {
+        workspace = &own;
+    }
+
+    int rotation;
+    while ((rotation = __atomic_add_fetch(&search->next_rotation, 1, __ATOMIC_RELAXED)) <= ROTATIONS_COUNT) {
+        if (workspace == NULL) {
+            __atomic_store_n(&search->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        char *rotated = workspace->rotated;
+        shift_into(rotated, search->cyphered_str, rotation, search->len);
+
+        // a tie with the best distance is still needed, a smaller shift wins it
+        int best_res = __atomic_load_n(&search->best_res, __ATOMIC_RELAXED);
+        int curr_res = levenstein_within(rotated, search->len, search->overheard_str, search->overheard_len, best_res,
+                                         workspace);
+        search->results[rotation] = curr_res;
+
+        while (curr_res >= 0 && curr_res < best_res
+               && !__atomic_compare_exchange_n(&search->best_res, &best_res, curr_res, 0,
+                                               __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    workspace_free(&own);
+    return NULL;
+}
+
+int online_cores(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores < 1 ? 1 : (int) cores;
+}
+
+int best_levenstein_offset(const char *cyphered_str, int len, const char *overheard_str, int threads,
+                           workspace_t *workspace) {
+    // only distances below the length of the cyphered string count
+    rotation_search_t search = { cyphered_str, len, overheard_str, strlen(overheard_str), 0, len - 1 };
+
+    // the buffers can serve only one thread
+    search.workspace = threads <= 1 ? workspace : NULL;
+
+    pthread_t workers[ROTATIONS_COUNT];
+    int started = 0;
+
+    // the calling thread is one of the workers
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, score_rotations, &search) == 0) {
+        ++started;
+    }
+
+    score_rotations(&search);
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    // the rotations claimed by a thread without buffers were never scored
+    if (search.failed) {
+        return -1;
+    }
+
+    // a rotation abandoned by its cutoff scored above the final best one
+    int best_res = len;
     int offset = 0;
 
-    for (int i = 0; i < ROTATIONS_COUNT; ++i) {
-        for (int j = 0; j < len; ++j) {
-            cyphered_str[j] = rotate(cyphered_str[j]);
+    for (int i = 1; i <= ROTATIONS_COUNT; ++i) {
+        if (search.results[i] >= 0 && search.results[i] < best_res) {
+            best_res = search.results[i];
+            offset = i;
         }
+    }
+
+    return offset;
+}
+
+int decypher(char *cyphered_str, const char *overheard_str, int (*compare)(const char *first_str, const char *second_str)) {
+    unsigned int len = strlen(cyphered_str);
+
+    // a thread is worth starting only for enough cells of the distance matrices
+    long long cells = (long long) len * (long long) strlen(overheard_str);
+    long long useful = cells / CELLS_PER_THREAD > 1 ? cells / CELLS_PER_THREAD : 1;
 
-        int curr_res = (*compare)(cyphered_str, overheard_str);
+    int cores = online_cores();
+    int threads = cores > ROTATIONS_COUNT ? ROTATIONS_COUNT : cores;
+    threads = threads > useful ? (int) useful : threads;
 
-        if ((compare == compare_hamming && curr_res > best_res) || 
-            (compare == compare_levenstein && curr_res < best_res)) 
-        {
-            best_res = curr_res;
-            offset = i + 1;
+    int offset = compare == compare_hamming ? best_hamming_offset(cyphered_str, overheard_str, len)
+                                            : best_levenstein_offset(cyphered_str, len, overheard_str, threads, NULL);
 
-        } 
+    if (offset < 0) {
+        return ERROR_INPUT;
     }
 
     shift(cyphered_str, offset, len);
+    return EXIT_SUCCESS;
+}
+
+char* read_input(size_t *size) {
+    size_t capacity = BATCH_BLOCK;
+    char *input = (char *) malloc(capacity + 1);
+    *size = 0;
+
+    while (input != NULL) {
+        if (*size == capacity) {
+            char *temp = (char *) realloc(input, capacity * 2 + 1);
+
+            if (temp == NULL) {
+                free(input);
+                return NULL;
+            }
+
+            input = temp;
+            capacity *= 2;
+        }
+
+        ssize_t got = read(STDIN_FILENO, input + *size, capacity - *size);
+
+        if (got == 0) {
+            break;
+
+        } else if (got < 0) {
+            free(input);
+            return NULL;
+        }
+
+        *size += got;
+    }
+
+    return input;
+}
+
+int split_pairs(char *input, size_t size, batch_t *batch) {
+    unsigned char classes[CHAR_VALUES] = { CLASS_INVALID };
+
+    for (int c = 'a'; c <= 'z'; ++c) {
+        classes[c] = CLASS_LETTER;
+        classes[c - 'a' + 'A'] = CLASS_LETTER;
+    }
+    classes['\n'] = CLASS_NEWLINE;
+
+    // a last line without a newline still counts
+    input[size] = '\n';
+    size_t lines = 0;
+    for (const char *pos = input; pos < input + size; ++lines) {
+        pos = (const char *) memchr(pos, '\n', input + size + 1 - pos) + 1;
+    }
+
+    batch->pairs = (batch_pair_t *) malloc(sizeof(batch_pair_t) * (lines / 2 + 1));
+    batch->count = 0;
+    batch->max_len = 0;
+
+    if (batch->pairs == NULL) {
+        return ERROR_INPUT;
+    }
+
+    char *pos = input;
+    char *end = input + size;
+
+    while (pos < end) {
+        batch_pair_t *pair = &batch->pairs[batch->count++];
+        pair->code = EXIT_SUCCESS;
+
+        // a missing overheard line reads as an empty one, like at the end of the input
+        for (int k = 0; k < STR_COUNT; ++k) {
+            char *line = pos;
+
+            while (classes[(unsigned char) *pos] == CLASS_LETTER) {
+                ++pos;
+            }
+
+            if (pos < end && classes[(unsigned char) *pos] == CLASS_INVALID) {
+                pair->code = ERROR_INPUT;
+                pos = (char *) memchr(pos, '\n', end + 1 - pos);
+            }
+
+            int len = pos - line;
+            *pos = '\0';
+            pos += pos < end;
+
+            if (k == 0) {
+                pair->cyphered_str = line;
+                pair->len = len;
+
+            } else {
+                pair->overheard_str = line;
+                pair->overheard_len = len;
+            }
+        }
+
+        if (pair->code == EXIT_SUCCESS && !batch->levenstein && pair->len != pair->overheard_len) {
+            pair->code = ERROR_RANGE;
+        }
+
+        if (pair->len > batch->max_len) {
+            batch->max_len = pair->len;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void* decode_pairs(void *arg) {
+    batch_t *batch = (batch_t *) arg;
+
+    // the buffers of every pair of this thread, the Hamming metric needs none
+    workspace_t workspace = { NULL, NULL, NULL, NULL, NULL };
+    int ready = batch->levenstein && workspace_init(&workspace, batch->max_len) == EXIT_SUCCESS;
+
+    size_t start;
+    while ((start = __atomic_fetch_add(&batch->next_pair, BATCH_CHUNK, __ATOMIC_RELAXED)) < batch->count) {
+        size_t end = start + BATCH_CHUNK < batch->count ? start + BATCH_CHUNK : batch->count;
+
+        for (size_t i = start; i < end; ++i) {
+            batch_pair_t *pair = &batch->pairs[i];
+
+            if (pair->code != EXIT_SUCCESS) {
+                continue;
+            }
+
+            // without the buffers the pair cannot be decoded
+            if (batch->levenstein && !ready) {
+                pair->code = ERROR_INPUT;
+                continue;
+            }
+
+            // the pairs are the parallel work, each one is decoded by a single thread
+            int offset = batch->levenstein
+                ? best_levenstein_offset(pair->cyphered_str, pair->len, pair->overheard_str, 1, &workspace)
+                : best_hamming_offset(pair->cyphered_str, pair->overheard_str, pair->len);
+
+            if (offset < 0) {
+                pair->code = ERROR_INPUT;
+                continue;
+            }
+
+            shift(pair->cyphered_str, offset, pair->len);
+        }
+    }
+
+    workspace_free(&workspace);
+    return NULL;
+}
+
+int run_batch(int levenstein, int threads) {
+    size_t size = 0;
+    char *input = read_input(&size);
+    batch_t batch = { NULL, 0, 0, levenstein, 0 };
+
+    if (input == NULL || split_pairs(input, size, &batch) != EXIT_SUCCESS) {
+        free(input);
+        handle_error(ERROR_INPUT);
+        return ERROR_INPUT;
+    }
+
+    pthread_t *workers = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+
+    if (workers == NULL) {
+        free(batch.pairs);
+        free(input);
+        handle_error(ERROR_INPUT);
+        return ERROR_INPUT;
+    }
+
+    int started = 0;
+
+    // the calling thread is one of the workers
+    while (started < threads - 1
+           && pthread_create(&workers[started], NULL, decode_pairs, &batch) == 0) {
+        ++started;
+    }
+
+    decode_pairs(&batch);
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+
+    // one large output buffer instead of a write per line
+    int ret_code = EXIT_SUCCESS;
+    setvbuf(stdout, NULL, _IOFBF, BATCH_BLOCK);
+
+    for (size_t i = 0; i < batch.count; ++i) {
+        const batch_pair_t *pair = &batch.pairs[i];
+
+        if (pair->code == EXIT_SUCCESS) {
+            fwrite(pair->cyphered_str, 1, pair->len, stdout);
+
+        } else if (ret_code == EXIT_SUCCESS) {
+            ret_code = pair->code;
+        }
+
+        putchar('\n');
+    }
+
+    fflush(stdout);
+    free(batch.pairs);
+    free(input);
+
+    handle_error(ret_code);
+    return ret_code;
 }
 
 void handle_free(char *first_str, char *second_str) {
@@ -0,0 +1,368 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "aho.h"
+#include "fold.h"
+
+/* dense rows are limited so that huge pattern sets keep a bounded table */
+#define MAX_DENSE_ROWS 4096
+/* sparse nodes with more edges than this use binary search */
+#define LINEAR_EDGES 8
+#define ROOT 0
+
+/* trie node used only while building, children form a sibling list */
+typedef struct {
+    int first_child;
+    int next_sibling;
+    int length;
+    unsigned char byte;
+} build_node_t;
+
+typedef struct {
+    build_node_t *nodes;
+    int num_nodes;
+    int capacity;
+} trie_t;
+
+static int trie_add(trie_t *trie, unsigned char byte) {
+    if (trie->num_nodes == trie->capacity) {
+        int capacity = trie->capacity ? trie->capacity * 2 : 1024;
+        build_node_t *nodes = (build_node_t *) realloc(trie->nodes, sizeof(build_node_t) * capacity);
+        if (!nodes) {
+            return -1;
+        }
+
+        trie->nodes = nodes;
+        trie->capacity = capacity;
+    }
+
+    build_node_t node = { -1, -1, 0, byte };
+    trie->nodes[trie->num_nodes] = node;
+    return trie->num_nodes++;
+}
+
+static bool trie_insert(trie_t *trie, const unsigned char *pattern, size_t length, bool icase) {
+    int node = ROOT;
+
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char byte = icase ? fold_byte(pattern[i]) : pattern[i];
+        int child = trie->nodes[node].first_child;
+        while (child >= 0 && trie->nodes[child].byte != byte) {
+            child = trie->nodes[child].next_sibling;
+        }
+
+        if (child < 0) {
+            child = trie_add(trie, byte);
+            if (child < 0) {
+                return false;
+            }
+
+            trie->nodes[child].next_sibling = trie->nodes[node].first_child;
+            trie->nodes[node].first_child = child;
+        }
+
+        node = child;
+    }
+
+    trie->nodes[node].length = (int) length;
+    return true;
+}
+
+static int compare_edges(const void *a, const void *b) {
+    return ((const aho_edge_t *) a)->byte - ((const aho_edge_t *) b)->byte;
+}
+
+/* child of node reached by byte, -1 if there is none */
+static inline int sparse_child(const aho_t *aho, const aho_node_t *node, unsigned char byte) {
+    const aho_edge_t *edges = aho->edges + node->edges;
+    int count = node->num_edges;
+
+    if (count <= LINEAR_EDGES) {
+        for (int i = 0; i < count; ++i) {
+            if (edges[i].byte == byte) {
+                return edges[i].target;
+            }
+        }
+        return -1;
+    }
+
+    int low = 0;
+    int high = count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+
+        if (edges[mid].byte == byte) {
+            return edges[mid].target;
+        } else if (edges[mid].byte < byte) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+static inline int step(const aho_t *aho, int state, unsigned char byte) {
+    while (true) {
+        const aho_node_t *node = &aho->nodes[state];
+
+        if (node->dense >= 0) {
+            return aho->dense[(size_t) node->dense * 256 + byte] >> 1;
+        }
+
+        // the trie holds folded bytes, the dense rows cover both cases already
+        int child = sparse_child(aho, node, aho->icase ? fold_byte(byte) : byte);
+        if (child >= 0) {
+            return child;
+        }
+
+        state = node->fail;
+    }
+}
+
+/* renumbers the trie breadth-first and lays out the edge runs */
+static bool layout(aho_t *aho, const trie_t *trie) {
+    int *order = (int *) malloc(sizeof(int) * trie->num_nodes);
+    int *index = (int *) malloc(sizeof(int) * trie->num_nodes);
+    aho->nodes = (aho_node_t *) malloc(sizeof(aho_node_t) * trie->num_nodes);
+    aho->edges = (aho_edge_t *) malloc(sizeof(aho_edge_t) * (trie->num_nodes + 1));
+
+    if (!order || !index || !aho->nodes || !aho->edges) {
+        free(order);
+        free(index);
+        return false;
+    }
+
+    int head = 0;
+    int tail = 0;
+    order[tail++] = ROOT;
+    index[ROOT] = 0;
+
+    while (head < tail) {
+        int old = order[head++];
+        for (int child = trie->nodes[old].first_child; child >= 0; child = trie->nodes[child].next_sibling) {
+            index[child] = tail;
+            order[tail++] = child;
+        }
+    }
+
+    int num_edges = 0;
+    for (int i = 0; i < trie->num_nodes; ++i) {
+        const build_node_t *old = &trie->nodes[order[i]];
+        aho_node_t *node = &aho->nodes[i];
+
+        node->fail = ROOT;
+        node->dense = -1;
+        node->edges = num_edges;
+        node->length = old->length;
+        node->output = -1;
+        node->depth = 0;
+
+        for (int child = old->first_child; child >= 0; child = trie->nodes[child].next_sibling) {
+            aho_edge_t edge = { trie->nodes[child].byte, index[child] };
+            aho->edges[num_edges++] = edge;
+        }
+
+        node->num_edges = num_edges - node->edges;
+        qsort(aho->edges + node->edges, node->num_edges, sizeof(aho_edge_t), compare_edges);
+    }
+
+    aho->num_nodes = trie->num_nodes;
+    free(order);
+    free(index);
+    return true;
+}
+
+/* failure and output links in breadth-first order, then the dense rows */
+static bool link(aho_t *aho) {
+    aho_node_t *nodes = aho->nodes;
+
+    for (int u = 0; u < aho->num_nodes; ++u) {
+        for (int e = 0; e < nodes[u].num_edges; ++e) {
+            const aho_edge_t *edge = &aho->edges[nodes[u].edges + e];
+            aho_node_t *child = &nodes[edge->target];
+            child->depth = nodes[u].depth + 1;
+
+            if (u != ROOT) {
+                int f = nodes[u].fail;
+                int next = sparse_child(aho, &nodes[f], edge->byte);
+
+                while (next < 0 && f != ROOT) {
+                    f = nodes[f].fail;
+                    next = sparse_child(aho, &nodes[f], edge->byte);
+                }
+
+                child->fail = next >= 0 ? next : ROOT;
+            }
+        }
+
+        // nodes are visited after their failure target, so its output is final
+        nodes[u].output = nodes[u].length > 0 ? u : (u == ROOT ? -1 : nodes[nodes[u].fail].output);
+    }
+
+    int rows = 0;
+    while (rows < aho->num_nodes && rows < MAX_DENSE_ROWS && nodes[rows].depth <= AHO_DENSE_DEPTH) {
+        ++rows;
+    }
+
+    aho->dense = (int *) malloc(sizeof(int) * 256 * rows);
+    if (!aho->dense) {
+        return false;
+    }
+
+    // entries hold the target shifted left, the low bit marks targets leaving the fast path
+    for (int u = 0; u < rows; ++u) {
+        int *row = aho->dense + (size_t) u * 256;
+
+        for (int c = 0; c < 256; ++c) {
+            unsigned char byte = aho->icase ? fold_byte((unsigned char) c) : (unsigned char) c;
+            int child = sparse_child(aho, &nodes[u], byte);
+
+            if (child >= 0) {
+                row[c] = child << 1 | (child >= rows || nodes[child].output >= 0);
+            } else {
+                row[c] = u == ROOT ? ROOT : aho->dense[(size_t) nodes[nodes[u].fail].dense * 256 + c];
+            }
+        }
+
+        nodes[u].dense = u;
+    }
+
+    return true;
+}
+
+bool aho_build(aho_t *aho, const char **patterns, const size_t *lengths, size_t count, bool icase) {
+    memset(aho, 0, sizeof(aho_t));
+    aho->icase = icase;
+
+    trie_t trie = { NULL, 0, 0 };
+    bool ok = trie_add(&trie, 0) == ROOT;
+
+    for (size_t i = 0; ok && i < count; ++i) {
+        if (lengths[i] == 0) {
+            aho->match_all = true;
+        }
+        if (lengths[i] > aho->max_length) {
+            aho->max_length = lengths[i];
+        }
+
+        ok = trie_insert(&trie, (const unsigned char *) patterns[i], lengths[i], icase);
+    }
+
+    ok = ok && layout(aho, &trie) && link(aho);
+    free(trie.nodes);
+
+    if (!ok) {
+        aho_free(aho);
+    }
+
+    return ok;
+}
+
+void aho_free(aho_t *aho) {
+    free(aho->nodes);
+    free(aho->edges);
+    free(aho->dense);
+    memset(aho, 0, sizeof(aho_t));
+}
+
+/* checks whether a pattern of exactly length bytes ends in state */
+static bool ends_with_length(const aho_t *aho, int state, int length) {
+    for (int out = aho->nodes[state].output; out >= 0; out = aho->nodes[aho->nodes[out].fail].output) {
+        if (aho->nodes[out].length == length) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* leftmost-longest occurrence inside a line known to contain one */
+static const char* exact_match(const aho_t *aho, const unsigned char *line, const unsigned char *end,
+                               size_t *match_length) {
+    const unsigned char *start = end;
+    int state = ROOT;
+
+    // leftmost start: the longest pattern ending at each position
+    for (const unsigned char *pos = line; pos < end; ) {
+        state = step(aho, state, *pos++);
+        int out = aho->nodes[state].output;
+
+        if (out >= 0 && pos - aho->nodes[out].length < start) {
+            start = pos - aho->nodes[out].length;
+        }
+
+        // no later occurrence can start before the current one
+        if (start < end && (size_t) (pos - start) >= aho->max_length) {
+            break;
+        }
+    }
+
+    // longest end among the patterns starting there
+    const unsigned char *stop = start;
+    state = ROOT;
+    for (const unsigned char *pos = line; pos < end && pos < start + aho->max_length; ) {
+        state = step(aho, state, *pos++);
+
+        if (pos > start && ends_with_length(aho, state, (int) (pos - start))) {
+            stop = pos;
+        }
+    }
+
+    *match_length = stop - start;
+    return (const char *) start;
+}
+
+const char* aho_find(const aho_t *aho, const char *text, size_t length, bool exact, size_t *match_length) {
+    const unsigned char *pos = (const unsigned char *) text;
+    const unsigned char *end = pos + length;
+
+    *match_length = 0;
+
+    if (aho->match_all) {
+        if (!exact) {
+            return text;
+        }
+
+        // every line matches, but the other patterns are still highlighted
+        const unsigned char *line_end = memchr(pos, '\n', length);
+        if (line_end != NULL) {
+            end = line_end;
+        }
+    }
+
+    // dense rows are numbered like their nodes, so the fast path needs only the table
+    int state = ROOT;
+    while (pos < end) {
+        int entry = aho->dense[(size_t) state * 256 + *pos++];
+        state = entry >> 1;
+
+        if (entry & 1) {
+            while (aho->nodes[state].output < 0 && aho->nodes[state].dense < 0 && pos < end) {
+                state = step(aho, state, *pos++);
+            }
+
+            if (aho->nodes[state].output >= 0) {
+                break;
+            }
+        }
+    }
+
+    if (aho->nodes[state].output < 0) {
+        return aho->match_all ? text : NULL;
+    }
+
+    if (!exact) {
+        *match_length = aho->nodes[aho->nodes[state].output].length;
+        return (const char *) pos - *match_length;
+    }
+
+    const unsigned char *line = pos;
+    while (line > (const unsigned char *) text && line[-1] != '\n') {
+        --line;
+    }
+
+    const unsigned char *line_end = memchr(pos, '\n', end - pos);
+    return exact_match(aho, line, line_end != NULL ? line_end : end, match_length);
+}
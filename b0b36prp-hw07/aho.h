@@ -0,0 +1,61 @@
+#ifndef __AHO_H__
+#define __AHO_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* trie levels up to this depth get a full 256-entry transition row */
+#define AHO_DENSE_DEPTH 2
+
+/* Automaton node, nodes are numbered in breadth-first order */
+typedef struct {
+    int fail;
+    int dense;
+    int edges;
+    int num_edges;
+    int depth;
+    int length;
+    int output;
+} aho_node_t;
+
+/* Sparse edge of a deep node */
+typedef struct {
+    unsigned char byte;
+    int target;
+} aho_edge_t;
+
+/*
+ * Aho-Corasick automaton. Nodes near the root store complete transition
+ * rows (with failures already resolved) in one contiguous table, deeper
+ * nodes store their few children as sorted edge runs and fall back along
+ * failure links until a dense node is reached.
+ */
+typedef struct {
+    aho_node_t *nodes;
+    int num_nodes;
+    int *dense;         /* target << 1 | whether it has output or is sparse */
+    aho_edge_t *edges;
+    size_t max_length;
+    bool match_all;
+    bool icase;
+} aho_t;
+
+/*
+ * Builds the automaton for count patterns given by their bytes and lengths,
+ * with icase ASCII letters match regardless of case
+ * returns: true on success; false when out of memory
+ */
+bool aho_build(aho_t *aho, const char **patterns, const size_t *lengths, size_t count, bool icase);
+
+/* frees all memory of the automaton */
+void aho_free(aho_t *aho);
+
+/*
+ * Finds the first line of text containing any of the patterns. With exact
+ * set the leftmost-longest occurrence in that line is returned, otherwise
+ * the first occurrence to end.
+ * returns: pointer to the occurrence and its length in *match_length; NULL if none
+ */
+const char* aho_find(const aho_t *aho, const char *text, size_t length, bool exact, size_t *match_length);
+
+#endif /* __AHO_H__ */
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "approx.h"
+#include "fold.h"
+
+static void build_masks(uint64_t *masks, int words, const unsigned char *pattern, size_t length,
+                        bool reverse, bool icase) {
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = pattern[reverse ? length - 1 - i : i];
+        uint64_t bit = (uint64_t) 1 << (i % APPROX_WORD_BITS);
+        size_t word = i / APPROX_WORD_BITS;
+
+        masks[(size_t) c * words + word] |= bit;
+
+        if (icase && (unsigned char) (fold_byte(c) - 'a') < 26) {
+            masks[(size_t) (c ^ 0x20) * words + word] |= bit;
+        }
+    }
+}
+
+bool approx_compile(approx_t *approx, const char *pattern, size_t length, int errors, bool icase) {
+    approx->length = length;
+    approx->errors = errors;
+    approx->words = (int) ((length + APPROX_WORD_BITS - 1) / APPROX_WORD_BITS);
+    approx->match_all = (size_t) errors >= length;
+    approx->masks = NULL;
+    approx->reverse_masks = NULL;
+
+    if (approx->match_all) {
+        return true;
+    }
+
+    size_t size = (size_t) 256 * approx->words;
+    approx->masks = (uint64_t *) calloc(size, sizeof(uint64_t));
+    approx->reverse_masks = (uint64_t *) calloc(size, sizeof(uint64_t));
+
+    if (approx->masks == NULL || approx->reverse_masks == NULL) {
+        approx_free(approx);
+        return false;
+    }
+
+    build_masks(approx->masks, approx->words, (const unsigned char *) pattern, length, false, icase);
+    build_masks(approx->reverse_masks, approx->words, (const unsigned char *) pattern, length, true, icase);
+    return true;
+}
+
+void approx_free(approx_t *approx) {
+    free(approx->masks);
+    free(approx->reverse_masks);
+    approx->masks = NULL;
+    approx->reverse_masks = NULL;
+}
+
+/*
+ * Wu-Manber for patterns of one word. Bit i of r[d] tells that the first
+ * i + 1 pattern bytes match text ending here with at most d errors; every
+ * error level costs a constant number of word operations per byte.
+ * returns: bytes consumed up to the end of the first match; -1 if none
+ */
+static long scan_word(const approx_t *approx, const unsigned char *text, size_t length) {
+    const uint64_t *masks = approx->masks;
+    int k = approx->errors;
+    uint64_t top = (uint64_t) 1 << (approx->length - 1);
+    uint64_t initial[APPROX_MAX_ERRORS + 1];
+    uint64_t r[APPROX_MAX_ERRORS + 1];
+
+    // d errors allow skipping the first d pattern bytes before any text
+    for (int d = 0; d <= k; ++d) {
+        initial[d] = ((uint64_t) 1 << d) - 1;
+        r[d] = initial[d];
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = text[i];
+
+        if (c == '\n') {
+            memcpy(r, initial, sizeof(uint64_t) * (k + 1));
+            continue;
+        }
+
+        uint64_t mask = masks[c];
+        uint64_t previous = r[0];
+        r[0] = ((r[0] << 1) | 1) & mask;
+
+        // match | insertion | substitution | deletion
+        for (int d = 1; d <= k; ++d) {
+            uint64_t old = r[d];
+            r[d] = (((old << 1) | 1) & mask) | previous | (previous << 1) | (r[d - 1] << 1) | 1;
+            previous = old;
+        }
+
+        if (r[k] & top) {
+            return (long) i + 1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Wu-Manber over state vectors of approx->words words, reading count bytes
+ * forwards from text or, with reverse, backwards from text. Unanchored
+ * matches may start anywhere and the first one to end is returned; an
+ * anchored match starts at text and the longest one is returned.
+ * returns: bytes consumed up to the end of the match; -1 if none
+ */
+static long scan_blocked(const approx_t *approx, const uint64_t *masks, const unsigned char *text,
+                         size_t count, bool reverse, bool anchored) {
+    int k = approx->errors;
+    int words = approx->words;
+    size_t top_word = (approx->length - 1) / APPROX_WORD_BITS;
+    uint64_t top = (uint64_t) 1 << ((approx->length - 1) % APPROX_WORD_BITS);
+
+    uint64_t *state = (uint64_t *) malloc(sizeof(uint64_t) * words * (k + 3));
+    if (state == NULL) {
+        return -1;
+    }
+
+    long found = -1;
+    size_t consumed = 0;    // bytes read since the last reset
+    bool reset = true;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (reset) {
+            memset(state, 0, sizeof(uint64_t) * words * (k + 1));
+            for (int d = 0; d <= k; ++d) {
+                state[(size_t) d * words] = ((uint64_t) 1 << d) - 1;
+            }
+
+            consumed = 0;
+            reset = false;
+        }
+
+        unsigned char c = reverse ? text[-1 - (long) i] : text[i];
+
+        if (c == '\n') {
+            if (anchored) {
+                break;
+            }
+
+            reset = true;
+            continue;
+        }
+
+        const uint64_t *mask = masks + (size_t) c * words;
+        uint64_t *old = state + (size_t) (k + 1) * words;
+        uint64_t *previous = old + words;
+
+        // the empty pattern prefix: always matched unanchored, anchored only
+        // while the bytes read so far can be insertions
+        for (int d = 0; d <= k; ++d) {
+            uint64_t *r = state + (size_t) d * words;
+            uint64_t *below = d > 0 ? r - words : r;
+
+            uint64_t carry = !anchored || consumed <= (size_t) d;
+            uint64_t carry_previous = !anchored || consumed + 1 <= (size_t) d;
+            uint64_t carry_below = !anchored || consumed + 2 <= (size_t) d;
+
+            memcpy(old, r, sizeof(uint64_t) * words);
+
+            for (int w = 0; w < words; ++w) {
+                uint64_t value = ((old[w] << 1) | carry) & mask[w];
+                carry = old[w] >> 63;
+
+                if (d > 0) {
+                    value |= previous[w] | (previous[w] << 1) | carry_previous | (below[w] << 1) | carry_below;
+                    carry_previous = previous[w] >> 63;
+                    carry_below = below[w] >> 63;
+                }
+
+                r[w] = value;
+            }
+
+            uint64_t *swap = old;
+            old = previous;
+            previous = swap;
+        }
+
+        ++consumed;
+
+        if (state[(size_t) k * words + top_word] & top) {
+            found = (long) i + 1;
+
+            if (!anchored) {
+                break;
+            }
+        }
+    }
+
+    free(state);
+    return found;
+}
+
+const char* approx_find(const approx_t *approx, const char *text, size_t length, bool exact,
+                        size_t *match_length) {
+    *match_length = 0;
+
+    if (approx->match_all) {
+        return text;
+    }
+
+    const unsigned char *start = (const unsigned char *) text;
+    long consumed = approx->words == 1
+        ? scan_word(approx, start, length)
+        : scan_blocked(approx, approx->masks, start, length, false, false);
+
+    if (consumed < 0) {
+        return NULL;
+    }
+
+    const unsigned char *end = start + consumed;
+
+    if (!exact) {
+        return (const char *) end - 1;
+    }
+
+    // a match is at most length + errors bytes long and never crosses a newline
+    const unsigned char *line = end;
+    size_t window = approx->length + approx->errors;
+
+    while (line > start && line[-1] != '\n' && (size_t) (end - line) < window) {
+        --line;
+    }
+
+    long back = scan_blocked(approx, approx->reverse_masks, end, end - line, true, true);
+    if (back < 0) {
+        back = 1; // only when out of memory, highlight the last byte
+    }
+
+    *match_length = (size_t) back;
+    return (const char *) end - back;
+}
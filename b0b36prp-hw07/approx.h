@@ -0,0 +1,48 @@
+#ifndef __APPROX_H__
+#define __APPROX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* upper bound of allowed errors, the state of every error level is kept in registers or on the stack */
+#define APPROX_MAX_ERRORS 32
+
+/* patterns up to this length fit one machine word, longer ones use the blocked matcher */
+#define APPROX_WORD_BITS 64
+
+/*
+ * Approximate pattern for the Wu-Manber k-differences matcher: a match is
+ * a piece of a line within edit distance errors of the pattern.
+ * masks hold words 64-bit words for every byte value, bit i is set when
+ * the byte may stand at pattern position i; reverse_masks do the same for
+ * the reversed pattern and locate the start of a match.
+ */
+typedef struct {
+    size_t length;
+    int errors;
+    int words;
+    bool match_all;
+    uint64_t *masks;
+    uint64_t *reverse_masks;
+} approx_t;
+
+/*
+ * Builds the masks, with icase ASCII letters match regardless of case
+ * returns: true on success; false when out of memory
+ */
+bool approx_compile(approx_t *approx, const char *pattern, size_t length, int errors, bool icase);
+
+/* frees the masks */
+void approx_free(approx_t *approx);
+
+/*
+ * Finds the first line containing an approximate match. With exact set the
+ * first match to end is returned with its leftmost start, otherwise only
+ * some position inside the matching line with *match_length 0.
+ * returns: pointer to the match; NULL if no line matches
+ */
+const char* approx_find(const approx_t *approx, const char *text, size_t length, bool exact,
+                        size_t *match_length);
+
+#endif /* __APPROX_H__ */
@@ -0,0 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+unsigned int bench_random(unsigned int *x) {
+    *x = *x * 1103515245u + 12345u;
+    return *x >> 16;
+}
+
+char* bench_make_text(size_t size) {
+    char *text = (char *) malloc(size);
+    if (!text) {
+        return NULL;
+    }
+
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyz      0123456789.:=-/[]";
+    unsigned int x = 12345;
+
+    for (size_t i = 0; i < size; ++i) {
+        text[i] = (i % 80 == 79) ? '\n' : alphabet[bench_random(&x) % (sizeof(alphabet) - 1)];
+    }
+
+    return text;
+}
@@ -0,0 +1,21 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stddef.h>
+
+/* Helpers shared by the benchmarks and the corpus generator */
+
+/* monotonic time in seconds */
+double bench_now(void);
+
+/* next value of the linear congruential generator with the state x, 15 bits */
+unsigned int bench_random(unsigned int *x);
+
+/*
+ * log-like text: lowercase words, digits and punctuation, 80 byte lines;
+ * the same size always gives the same text
+ * returns: the malloc'ed text of size bytes; NULL if allocation fails
+ */
+char* bench_make_text(size_t size);
+
+#endif /* __BENCH_H__ */
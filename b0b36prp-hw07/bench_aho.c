@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aho.h"
+#include "bench.h"
+
+#define DEFAULT_MB 64
+#define REPEATS 3
+#define MB (1024 * 1024)
+#define MIN_PATTERN 4
+#define MAX_PATTERN 16
+
+static const size_t pattern_counts[] = { 10, 1000, 100000 };
+
+/* lowercase words of MIN_PATTERN to MAX_PATTERN letters, one in ten is taken from the text */
+static char* make_patterns(const char *text, size_t size, size_t count, const char **patterns, size_t *lengths) {
+    char *data = (char *) malloc(count * MAX_PATTERN);
+    if (!data) {
+        return NULL;
+    }
+
+    unsigned int x = 54321;
+
+    for (size_t i = 0; i < count; ++i) {
+        char *pattern = data + i * MAX_PATTERN;
+        size_t length = MIN_PATTERN + bench_random(&x) % (MAX_PATTERN - MIN_PATTERN + 1);
+
+        for (size_t j = 0; j < length; ++j) {
+            pattern[j] = 'a' + bench_random(&x) % 26;
+        }
+
+        if (i % 10 == 0) {
+            size_t pos = ((size_t) bench_random(&x) << 16 | bench_random(&x)) % (size - MAX_PATTERN);
+            memcpy(pattern, text + pos, length);
+            if (memchr(pattern, '\n', length) != NULL) {
+                memset(pattern, 'q', length);
+            }
+        }
+
+        patterns[i] = pattern;
+        lengths[i] = length;
+    }
+
+    return data;
+}
+
+/* counts all lines with an occurrence so the whole buffer is scanned */
+static size_t count_lines(const aho_t *aho, const char *text, size_t size) {
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        size_t match_length;
+        const char *match = aho_find(aho, text + pos, size - pos, false, &match_length);
+        if (match == NULL) {
+            break;
+        }
+
+        ++count;
+        const char *newline = memchr(match, '\n', text + size - match);
+        pos = newline != NULL ? (size_t) (newline - text) + 1 : size;
+    }
+
+    return count;
+}
+
+/*
+ * BENCHMARK
+ * - usage: bench_aho [megabytes]
+ * - prints automaton build time and scan throughput for growing pattern sets
+ */
+int main(int argc, char *argv[]) {
+    size_t size = (size_t) (argc > 1 ? atoi(argv[1]) : DEFAULT_MB) * MB;
+    char *text = bench_make_text(size);
+    if (!text) {
+        fprintf(stderr, "Could not allocate text.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t p = 0; p < sizeof(pattern_counts) / sizeof(pattern_counts[0]); ++p) {
+        size_t count = pattern_counts[p];
+        const char **patterns = (const char **) malloc(sizeof(const char *) * count);
+        size_t *lengths = (size_t *) malloc(sizeof(size_t) * count);
+        char *data = patterns && lengths ? make_patterns(text, size, count, patterns, lengths) : NULL;
+
+        aho_t aho;
+        double start = bench_now();
+        if (!data || !aho_build(&aho, patterns, lengths, count, false)) {
+            fprintf(stderr, "Could not build the automaton.\n");
+            return EXIT_FAILURE;
+        }
+        double build = bench_now() - start;
+
+        double fastest = 0;
+        size_t lines = 0;
+        for (int r = 0; r < REPEATS; ++r) {
+            start = bench_now();
+            lines = count_lines(&aho, text, size);
+            double elapsed = bench_now() - start;
+
+            if (r == 0 || elapsed < fastest) {
+                fastest = elapsed;
+            }
+        }
+
+        printf("%6zu patterns: %7d nodes, build %8.2f ms, scan %6.2f GB/s (%zu lines)\n",
+               count, aho.num_nodes, build * 1e3, size / fastest / 1e9, lines);
+
+        aho_free(&aho);
+        free(data);
+        free(patterns);
+        free(lengths);
+    }
+
+    free(text);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "search.h"
+#include "writer.h"
+
+#define REPEATS 3
+#define DEFAULT_GREP "./hw07-b0b36prp"
+#define MAX_ARGS 8
+
+/* How the reference decides which part of a line matches */
+typedef enum {
+    REFERENCE_LITERAL,      /* the last argument as a fixed string */
+    REFERENCE_REGEX,        /* the last argument as a POSIX extended regex */
+    REFERENCE_PATTERNS      /* any of the fixed strings in patterns[] */
+} reference_t;
+
+/* One timed command line, the corpus is appended to the arguments */
+typedef struct {
+    const char *name;
+    const char *args[MAX_ARGS];
+    reference_t reference;
+    bool coloring;
+} bench_case_t;
+
+/* phrases of gen_corpus, written to the -f file */
+static const char *patterns[] = {
+    "ERROR",
+    "session-expired",
+    "connection refused",
+    "disk full",
+    "timeout=9"
+};
+
+#define PATTERNS_FILE "@patterns"
+
+static const bench_case_t cases[] = {
+    { "literal", { "ERROR" }, REFERENCE_LITERAL, false },
+    { "literal -c", { "-c", "ERROR" }, REFERENCE_LITERAL, false },
+    { "-E", { "-E", "timeout=[0-9]+|disk (full|quota)" }, REFERENCE_REGEX, false },
+    { "--color", { "--color=always", "session-expired" }, REFERENCE_LITERAL, true },
+    { "-E --color", { "-E", "--color=always", "timeout=[0-9]+" }, REFERENCE_REGEX, true },
+    { "-f (5 patterns)", { "-f", PATTERNS_FILE }, REFERENCE_PATTERNS, false }
+};
+
+static char* read_file(const char *filename, size_t *size) {
+    FILE *file = fopen(filename, "r");
+    struct stat info;
+
+    if (!file || fstat(fileno(file), &info) != 0) {
+        if (file) {
+            fclose(file);
+        }
+        return NULL;
+    }
+
+    *size = (size_t) info.st_size;
+    char *data = (char *) malloc(*size + 1);
+
+    if (data && fread(data, 1, *size, file) != *size) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    return data;
+}
+
+static bool counting(const bench_case_t *bench) {
+    return strcmp(bench->args[0], "-c") == 0;
+}
+
+static const char* last_arg(const bench_case_t *bench) {
+    int i = 0;
+    while (i + 1 < MAX_ARGS && bench->args[i + 1]) {
+        ++i;
+    }
+    return bench->args[i];
+}
+
+/* leftmost-longest match in the zero-terminated text, the way grep.c reports it */
+static const char* reference_find(const bench_case_t *bench, const regex_t *regex, const char *text,
+                                  bool line_start, size_t *match_length) {
+    if (bench->reference == REFERENCE_LITERAL) {
+        *match_length = strlen(last_arg(bench));
+        return strstr(text, last_arg(bench));
+    }
+
+    if (bench->reference == REFERENCE_REGEX) {
+        regmatch_t match;
+        if (regexec(regex, text, 1, &match, line_start ? 0 : REG_NOTBOL) != 0) {
+            return NULL;
+        }
+
+        *match_length = match.rm_eo - match.rm_so;
+        return text + match.rm_so;
+    }
+
+    const char *best = NULL;
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+        const char *match = strstr(text, patterns[p]);
+        size_t length = strlen(patterns[p]);
+
+        if (match && (!best || match < best || (match == best && length > *match_length))) {
+            best = match;
+            *match_length = length;
+        }
+    }
+
+    return best;
+}
+
+/* output of the case computed line by line, returns the number of matching lines */
+static size_t reference_output(const bench_case_t *bench, const regex_t *regex, const char *text, size_t size,
+                               writer_t *out) {
+    size_t capacity = 1024;
+    char *line = (char *) malloc(capacity);
+    size_t count = 0;
+
+    for (size_t pos = 0; line && pos < size; ) {
+        const char *newline = memchr(text + pos, '\n', size - pos);
+        size_t length = newline ? (size_t) (newline - text) - pos : size - pos;
+
+        if (length + 1 > capacity) {
+            capacity = 2 * (length + 1);
+            free(line);
+            line = (char *) malloc(capacity);
+            if (!line) {
+                break;
+            }
+        }
+
+        memcpy(line, text + pos, length);
+        line[length] = '\0';
+        pos += length + 1;
+
+        size_t match_length = 0;
+        const char *match = reference_find(bench, regex, line, true, &match_length);
+        if (!match) {
+            continue;
+        }
+
+        ++count;
+        if (counting(bench)) {
+            continue;
+        }
+
+        const char *start = line;
+        while (bench->coloring && match) {
+            const char *from = match + match_length;
+
+            if (match_length > 0) {
+                writer_write(out, start, match - start);
+                writer_puts(out, COLOR_START);
+                writer_write(out, match, match_length);
+                writer_puts(out, COLOR_END);
+                start = from;
+
+            } else if (*match) {
+                ++from;
+
+            } else {
+                break;
+            }
+
+            match = reference_find(bench, regex, from, false, &match_length);
+        }
+
+        writer_write(out, start, line + length - start);
+        writer_putc(out, '\n');
+    }
+
+    if (counting(bench)) {
+        char number[32];
+        snprintf(number, sizeof(number), "%zu\n", count);
+        writer_puts(out, number);
+    }
+
+    free(line);
+    return count;
+}
+
+/* runs grep once with stdout going to the output descriptor, returns the elapsed time or a negative value */
+static double run_grep(const char *grep, const bench_case_t *bench, const char *patterns_file, const char *corpus,
+                       int output) {
+    const char *argv[MAX_ARGS + 3] = { grep };
+    int argc = 1;
+
+    for (int i = 0; i < MAX_ARGS && bench->args[i]; ++i) {
+        argv[argc++] = strcmp(bench->args[i], PATTERNS_FILE) == 0 ? patterns_file : bench->args[i];
+    }
+    argv[argc++] = corpus;
+
+    if (ftruncate(output, 0) != 0 || lseek(output, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    double start = bench_now();
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        dup2(output, STDOUT_FILENO);
+        execv(grep, (char *const *) argv);
+        _exit(127);
+    }
+
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) > 1) {
+        return -1;
+    }
+
+    return bench_now() - start;
+}
+
+/* compares the descriptor's contents with the expected output */
+static bool verify(int output, const writer_t *expected) {
+    struct stat info;
+    if (fstat(output, &info) != 0 || (size_t) info.st_size != expected->length) {
+        return false;
+    }
+
+    char *data = (char *) malloc(expected->length + 1);
+    bool same = data && pread(output, data, expected->length, 0) == (ssize_t) expected->length
+        && memcmp(data, expected->data, expected->length) == 0;
+
+    free(data);
+    return same;
+}
+
+/*
+ * BENCHMARK
+ * - usage: bench_grep CORPUS [GREP]
+ * - times literal, -E, --color and -f searches of the corpus (see gen_corpus)
+ *   by the grep binary and checks every output against a line-by-line
+ *   reference matcher; exits with failure if any output differs
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Provide a corpus.\n");
+        return EXIT_FAILURE;
+    }
+
+    const char *corpus = argv[1];
+    const char *grep = argc > 2 ? argv[2] : DEFAULT_GREP;
+
+    size_t size = 0;
+    char *text = read_file(corpus, &size);
+    if (!text) {
+        fprintf(stderr, "Could not read corpus.\n");
+        return EXIT_FAILURE;
+    }
+
+    char patterns_file[] = "/tmp/bench_grep_patterns_XXXXXX";
+    char output_file[] = "/tmp/bench_grep_output_XXXXXX";
+    int patterns_fd = mkstemp(patterns_file);
+    int output = mkstemp(output_file);
+
+    if (patterns_fd < 0 || output < 0) {
+        fprintf(stderr, "Could not create temporary files.\n");
+        return EXIT_FAILURE;
+    }
+
+    unlink(output_file);
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+        if (write(patterns_fd, patterns[p], strlen(patterns[p])) < 0 || write(patterns_fd, "\n", 1) != 1) {
+            fprintf(stderr, "Could not write patterns.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    close(patterns_fd);
+
+    bool all_same = true;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        const bench_case_t *bench = &cases[c];
+
+        regex_t regex;
+        if (bench->reference == REFERENCE_REGEX && regcomp(&regex, last_arg(bench), REG_EXTENDED) != 0) {
+            fprintf(stderr, "Could not compile %s.\n", last_arg(bench));
+            return EXIT_FAILURE;
+        }
+
+        writer_t expected;
+        writer_init(&expected, -1);
+        size_t lines = reference_output(bench, &regex, text, size, &expected);
+
+        double fastest = -1;
+        for (int r = 0; r < REPEATS; ++r) {
+            double elapsed = run_grep(grep, bench, patterns_file, corpus, output);
+
+            if (elapsed >= 0 && (fastest < 0 || elapsed < fastest)) {
+                fastest = elapsed;
+            }
+        }
+
+        bool same = fastest >= 0 && verify(output, &expected);
+        all_same = all_same && same;
+
+        printf("%-16s %8.2f ms %6.2f GB/s %9zu lines  %s\n", bench->name, fastest * 1e3,
+               fastest > 0 ? size / fastest / 1e9 : 0.0, lines, same ? "ok" : "MISMATCH");
+
+        writer_free(&expected);
+        if (bench->reference == REFERENCE_REGEX) {
+            regfree(&regex);
+        }
+    }
+
+    unlink(patterns_file);
+    close(output);
+    free(text);
+    return all_same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "literal.h"
+#include "simd.h"
+
+#define DEFAULT_MB 256
+#define REPEATS 3
+#define MB (1024 * 1024)
+
+static const char *patterns[] = {
+    "ERROR",
+    "timeout=",
+    "session-expired!",
+    "connection reset by peer on port",
+    "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+};
+
+static const char *level_names[] = { "scalar", "sse2", "avx2" };
+
+/* counts all occurrences so the whole buffer is scanned */
+static size_t count_all(const literal_t *literal, const char *text, size_t size) {
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        const char *match = literal_find(literal, text + pos, size - pos);
+        if (match == NULL) {
+            break;
+        }
+
+        ++count;
+        pos = match - text + 1;
+    }
+
+    return count;
+}
+
+/*
+ * BENCHMARK
+ * - usage: bench_literal [megabytes]
+ * - prints literal search throughput for each kernel the CPU supports,
+ *   case-sensitive and with -i
+ */
+int main(int argc, char *argv[]) {
+    size_t size = (size_t) (argc > 1 ? atoi(argv[1]) : DEFAULT_MB) * MB;
+    char *text = bench_make_text(size);
+    if (!text) {
+        fprintf(stderr, "Could not allocate text.\n");
+        return EXIT_FAILURE;
+    }
+
+    simd_level_t best = simd_level();
+
+    for (size_t k = 0; k < 2 * sizeof(patterns) / sizeof(patterns[0]); ++k) {
+        size_t p = k / 2;
+        bool icase = k % 2 == 1;
+
+        literal_t literal;
+        literal_compile(&literal, patterns[p], strlen(patterns[p]), icase);
+        printf("pattern length %2zu%s:", literal.length, icase ? " -i" : "   ");
+
+        for (int level = SIMD_NONE; level <= best; ++level) {
+            simd_force_level((simd_level_t) level);
+
+            double fastest = 0;
+            size_t count = 0;
+            for (int r = 0; r < REPEATS; ++r) {
+                double start = bench_now();
+                count = count_all(&literal, text, size);
+                double elapsed = bench_now() - start;
+
+                if (r == 0 || elapsed < fastest) {
+                    fastest = elapsed;
+                }
+            }
+
+            printf("  %s %6.2f GB/s (%zu)", level_names[level], size / fastest / 1e9, count);
+        }
+
+        printf("\n");
+        literal_free(&literal);
+    }
+
+    free(text);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1199 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ere.h"
+#include "fold.h"
+
+/* largest count accepted in a {m,n} bound */
+#define MAX_REPEAT 255
+#define REPEAT_INFINITE -1
+#define HASH_SIZE (2 * ERE_MAX_DFA_STATES)
+
+/* - parser ------------------------------------------------------------------ */
+
+typedef enum {
+    NODE_EMPTY,
+    NODE_SET,
+    NODE_CONCAT,
+    NODE_ALT,
+    NODE_REPEAT,
+    NODE_BOL,
+    NODE_EOL
+} node_type_t;
+
+/* AST node, children are indices into the parser's node pool */
+typedef struct {
+    node_type_t type;
+    int left;
+    int right;
+    int set;
+    int min;
+    int max;
+} node_t;
+
+typedef struct {
+    const unsigned char *pattern;
+    size_t pos;
+    int depth;
+    node_t *nodes;
+    int num_nodes;
+    int capacity;
+    ere_t *ere;
+    bool icase;
+    const char *error;
+} parser_t;
+
+static inline void charset_add(charset_t *set, unsigned char c) {
+    set->bits[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+static inline bool charset_has(const charset_t *set, unsigned char c) {
+    return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static void charset_negate(charset_t *set) {
+    for (int i = 0; i < 4; ++i) {
+        set->bits[i] = ~set->bits[i];
+    }
+}
+
+/* adds the other case of every ASCII letter in the set */
+static void charset_fold(charset_t *set) {
+    for (int c = 'a'; c <= 'z'; ++c) {
+        if (charset_has(set, (unsigned char) c) || charset_has(set, (unsigned char) (c ^ 0x20))) {
+            charset_add(set, (unsigned char) c);
+            charset_add(set, (unsigned char) (c ^ 0x20));
+        }
+    }
+}
+
+static int add_node(parser_t *parser, node_type_t type, int left, int right) {
+    if (parser->num_nodes == parser->capacity) {
+        int capacity = parser->capacity ? parser->capacity * 2 : 64;
+        node_t *nodes = (node_t *) realloc(parser->nodes, sizeof(node_t) * capacity);
+        if (!nodes) {
+            parser->error = "Out of memory";
+            return -1;
+        }
+
+        parser->nodes = nodes;
+        parser->capacity = capacity;
+    }
+
+    node_t node = { type, left, right, -1, 0, 0 };
+    parser->nodes[parser->num_nodes] = node;
+    return parser->num_nodes++;
+}
+
+/* case folding happens here, so it turns into byte classes like any other set */
+static int add_set_node(parser_t *parser, const charset_t *set) {
+    ere_t *ere = parser->ere;
+    charset_t *sets = (charset_t *) realloc(ere->sets, sizeof(charset_t) * (ere->num_sets + 1));
+    if (!sets) {
+        parser->error = "Out of memory";
+        return -1;
+    }
+
+    ere->sets = sets;
+    ere->sets[ere->num_sets] = *set;
+
+    if (parser->icase) {
+        charset_fold(&ere->sets[ere->num_sets]);
+    }
+
+    int node = add_node(parser, NODE_SET, -1, -1);
+    if (node >= 0) {
+        parser->nodes[node].set = ere->num_sets++;
+    }
+
+    return node;
+}
+
+static int add_char_node(parser_t *parser, unsigned char c) {
+    charset_t set = { { 0, 0, 0, 0 } };
+    charset_add(&set, c);
+    return add_set_node(parser, &set);
+}
+
+/* fills the set with all bytes of a [:name:] class */
+static bool named_class(const char *name, size_t length, charset_t *set) {
+    static const struct {
+        const char *name;
+        int (*test)(int c);
+    } classes[] = {
+        { "alpha", isalpha }, { "digit", isdigit }, { "alnum", isalnum },
+        { "upper", isupper }, { "lower", islower }, { "space", isspace },
+        { "blank", isblank }, { "punct", ispunct }, { "print", isprint },
+        { "graph", isgraph }, { "cntrl", iscntrl }, { "xdigit", isxdigit }
+    };
+
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); ++i) {
+        if (strlen(classes[i].name) == length && strncmp(classes[i].name, name, length) == 0) {
+            for (int c = 0; c < 256; ++c) {
+                if (classes[i].test(c)) {
+                    charset_add(set, (unsigned char) c);
+                }
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int parse_bracket(parser_t *parser) {
+    const unsigned char *p = parser->pattern;
+    charset_t set = { { 0, 0, 0, 0 } };
+    bool negate = false;
+    bool first = true;
+
+    if (p[parser->pos] == '^') {
+        negate = true;
+        ++parser->pos;
+    }
+
+    while (true) {
+        unsigned char c = p[parser->pos];
+
+        if (c == '\0') {
+            parser->error = "Unmatched [";
+            return -1;
+        }
+
+        if (c == ']' && !first) {
+            ++parser->pos;
+            break;
+        }
+
+        first = false;
+
+        if (c == '[' && p[parser->pos + 1] == ':') {
+            const char *name = (const char *) p + parser->pos + 2;
+            const char *close = strstr(name, ":]");
+
+            if (close == NULL || !named_class(name, close - name, &set)) {
+                parser->error = "Invalid character class name";
+                return -1;
+            }
+
+            parser->pos = (const unsigned char *) close + 2 - p;
+            continue;
+        }
+
+        ++parser->pos;
+
+        if (p[parser->pos] == '-' && p[parser->pos + 1] != ']' && p[parser->pos + 1] != '\0') {
+            unsigned char last = p[parser->pos + 1];
+            parser->pos += 2;
+
+            if (last < c) {
+                parser->error = "Invalid range end";
+                return -1;
+            }
+
+            for (int b = c; b <= last; ++b) {
+                charset_add(&set, (unsigned char) b);
+            }
+
+        } else {
+            charset_add(&set, c);
+        }
+    }
+
+    // [^a] must exclude both cases, fold before negating
+    if (negate && parser->icase) {
+        charset_fold(&set);
+    }
+
+    if (negate) {
+        charset_negate(&set);
+    }
+
+    // a line never contains its newline, keep it out of every set
+    set.bits['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+
+    return add_set_node(parser, &set);
+}
+
+static int parse_escape(parser_t *parser) {
+    unsigned char c = parser->pattern[parser->pos];
+    charset_t set = { { 0, 0, 0, 0 } };
+
+    if (c == '\0') {
+        parser->error = "Trailing backslash";
+        return -1;
+    }
+
+    ++parser->pos;
+
+    switch (c) {
+        case 'w':
+        case 'W':
+            named_class("alnum", 5, &set);
+            charset_add(&set, '_');
+            break;
+        case 's':
+        case 'S':
+            named_class("space", 5, &set);
+            break;
+        case 'd':
+        case 'D':
+            named_class("digit", 5, &set);
+            break;
+        default:
+            return add_char_node(parser, c);
+    }
+
+    if (isupper(c)) {
+        charset_negate(&set);
+        set.bits['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+    }
+
+    return add_set_node(parser, &set);
+}
+
+static int parse_alternation(parser_t *parser);
+
+static int parse_atom(parser_t *parser) {
+    unsigned char c = parser->pattern[parser->pos++];
+
+    switch (c) {
+        case '(': {
+            parser->depth += 1;
+            int node = parse_alternation(parser);
+            if (node < 0) {
+                return -1;
+            }
+
+            if (parser->pattern[parser->pos] != ')') {
+                parser->error = "Unmatched ( or \\(";
+                return -1;
+            }
+
+            ++parser->pos;
+            parser->depth -= 1;
+            return node;
+        }
+
+        case '[':
+            return parse_bracket(parser);
+
+        case '\\':
+            return parse_escape(parser);
+
+        case '.': {
+            charset_t set = { { 0, 0, 0, 0 } };
+            charset_negate(&set);
+            set.bits['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+            return add_set_node(parser, &set);
+        }
+
+        case '^':
+            return add_node(parser, NODE_BOL, -1, -1);
+
+        case '$':
+            return add_node(parser, NODE_EOL, -1, -1);
+
+        default:
+            // a quantifier with nothing to repeat is taken literally, like GNU grep does
+            return add_char_node(parser, c);
+    }
+}
+
+/* parses a {m}, {m,} or {m,n} bound, leaves pos untouched if it is not one */
+static bool parse_bound(parser_t *parser, int *min, int *max) {
+    const char *start = (const char *) parser->pattern + parser->pos + 1;
+    char *end = NULL;
+
+    if (!isdigit((unsigned char) *start)) {
+        return false;
+    }
+
+    long low = strtol(start, &end, 10);
+    long high = low;
+
+    if (*end == ',') {
+        ++end;
+        high = REPEAT_INFINITE;
+
+        if (isdigit((unsigned char) *end)) {
+            high = strtol(end, &end, 10);
+        }
+    }
+
+    if (*end != '}' || low > MAX_REPEAT || high > MAX_REPEAT || (high != REPEAT_INFINITE && high < low)) {
+        return false;
+    }
+
+    *min = (int) low;
+    *max = (int) high;
+    parser->pos = end + 1 - (const char *) parser->pattern;
+
+    return true;
+}
+
+static int parse_repeat(parser_t *parser) {
+    int node = parse_atom(parser);
+
+    while (node >= 0) {
+        unsigned char c = parser->pattern[parser->pos];
+        int min = 0;
+        int max = 0;
+
+        if (c == '*') {
+            min = 0;
+            max = REPEAT_INFINITE;
+            ++parser->pos;
+
+        } else if (c == '+') {
+            min = 1;
+            max = REPEAT_INFINITE;
+            ++parser->pos;
+
+        } else if (c == '?') {
+            min = 0;
+            max = 1;
+            ++parser->pos;
+
+        } else if (c != '{' || !parse_bound(parser, &min, &max)) {
+            break;
+        }
+
+        int repeat = add_node(parser, NODE_REPEAT, node, -1);
+        if (repeat >= 0) {
+            parser->nodes[repeat].min = min;
+            parser->nodes[repeat].max = max;
+        }
+        node = repeat;
+    }
+
+    return node;
+}
+
+static int parse_concatenation(parser_t *parser) {
+    int node = -1;
+
+    while (true) {
+        unsigned char c = parser->pattern[parser->pos];
+
+        if (c == '\0' || c == '|' || (c == ')' && parser->depth > 0)) {
+            break;
+        }
+
+        if (c == ')') {
+            parser->error = "Unmatched ) or \\)";
+            return -1;
+        }
+
+        int next = parse_repeat(parser);
+        if (next < 0) {
+            return -1;
+        }
+
+        node = node < 0 ? next : add_node(parser, NODE_CONCAT, node, next);
+        if (node < 0) {
+            return -1;
+        }
+    }
+
+    return node < 0 ? add_node(parser, NODE_EMPTY, -1, -1) : node;
+}
+
+static int parse_alternation(parser_t *parser) {
+    int node = parse_concatenation(parser);
+
+    while (node >= 0 && parser->pattern[parser->pos] == '|') {
+        ++parser->pos;
+
+        int right = parse_concatenation(parser);
+        if (right < 0) {
+            return -1;
+        }
+
+        node = add_node(parser, NODE_ALT, node, right);
+    }
+
+    return node;
+}
+
+/* - required literals ------------------------------------------------------- */
+
+/* runs of bytes collected into ere->literals */
+typedef struct {
+    const node_t *nodes;
+    const charset_t *sets;
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t run_start;
+    int count;
+    bool failed;
+} literals_t;
+
+/* the byte a set stands for once case is folded; -1 if it stands for more */
+static int set_literal(const charset_t *set) {
+    int byte = -1;
+
+    for (int c = 0; c < 256; ++c) {
+        if (charset_has(set, (unsigned char) c)) {
+            int folded = fold_byte((unsigned char) c);
+
+            if (byte >= 0 && byte != folded) {
+                return -1;
+            }
+            byte = folded;
+        }
+    }
+
+    return byte;
+}
+
+static void literals_append(literals_t *literals, char c) {
+    if (literals->length + 1 >= literals->capacity) {
+        size_t capacity = literals->capacity ? literals->capacity * 2 : 64;
+        char *data = (char *) realloc(literals->data, capacity);
+
+        if (!data) {
+            literals->failed = true;
+            return;
+        }
+
+        literals->data = data;
+        literals->capacity = capacity;
+    }
+
+    literals->data[literals->length++] = c;
+}
+
+/* closes the current run, empty runs are dropped */
+static void literals_end_run(literals_t *literals) {
+    if (literals->length > literals->run_start) {
+        literals_append(literals, '\0');
+        literals->count += 1;
+    }
+
+    literals->run_start = literals->length;
+}
+
+/* collects the byte runs every match of the node must contain, left to right */
+static void collect_literals(literals_t *literals, int index) {
+    const node_t *node = &literals->nodes[index];
+    int byte = -1;
+
+    switch (node->type) {
+        case NODE_SET:
+            byte = set_literal(&literals->sets[node->set]);
+            if (byte >= 0) {
+                literals_append(literals, (char) byte);
+            } else {
+                literals_end_run(literals);
+            }
+            break;
+
+        case NODE_CONCAT:
+            collect_literals(literals, node->left);
+            collect_literals(literals, node->right);
+            break;
+
+        case NODE_REPEAT:
+            if (node->min == 0) {
+                literals_end_run(literals);
+                break;
+            }
+
+            // x{2,} continues the run with xx and starts the next one with xx again
+            if (literals->nodes[node->left].type == NODE_SET
+                && (byte = set_literal(&literals->sets[literals->nodes[node->left].set])) >= 0) {
+                for (int i = 0; i < node->min; ++i) {
+                    literals_append(literals, (char) byte);
+                }
+
+                if (node->max != node->min) {
+                    literals_end_run(literals);
+
+                    for (int i = 0; i < node->min; ++i) {
+                        literals_append(literals, (char) byte);
+                    }
+                }
+                break;
+            }
+
+            literals_end_run(literals);
+            collect_literals(literals, node->left);
+            literals_end_run(literals);
+            break;
+
+        case NODE_EMPTY:
+            break;
+
+        default:
+            // an alternative requires nothing of its own, anchors end the run
+            literals_end_run(literals);
+            break;
+    }
+}
+
+/* - NFA construction -------------------------------------------------------- */
+
+static int nfa_add(nfa_t *nfa, nfa_type_t type, int out, int out1, int set) {
+    if (nfa->num_states == ERE_MAX_NFA_STATES) {
+        return -1;
+    }
+
+    if (nfa->num_states == nfa->capacity) {
+        int capacity = nfa->capacity ? nfa->capacity * 2 : 64;
+        nfa_state_t *states = (nfa_state_t *) realloc(nfa->states, sizeof(nfa_state_t) * capacity);
+        if (!states) {
+            return -1;
+        }
+
+        nfa->states = states;
+        nfa->capacity = capacity;
+    }
+
+    nfa_state_t state = { type, out, out1, set };
+    nfa->states[nfa->num_states] = state;
+    return nfa->num_states++;
+}
+
+/*
+ * Compiles the node so that it continues to next, right to left like a
+ * continuation; reverse builds the NFA of the reversed language
+ * returns: the entry state; -1 if the NFA would be too large
+ */
+static int compile_node(const node_t *nodes, int index, int next, bool reverse, nfa_t *nfa) {
+    const node_t *node = &nodes[index];
+
+    if (next < 0) {
+        return -1;
+    }
+
+    switch (node->type) {
+        case NODE_EMPTY:
+            return next;
+
+        case NODE_SET:
+            return nfa_add(nfa, NFA_SET, next, -1, node->set);
+
+        case NODE_BOL:
+            return nfa_add(nfa, reverse ? NFA_EOL : NFA_BOL, next, -1, -1);
+
+        case NODE_EOL:
+            return nfa_add(nfa, reverse ? NFA_BOL : NFA_EOL, next, -1, -1);
+
+        case NODE_CONCAT:
+            if (reverse) {
+                return compile_node(nodes, node->right, compile_node(nodes, node->left, next, reverse, nfa), reverse, nfa);
+            }
+            return compile_node(nodes, node->left, compile_node(nodes, node->right, next, reverse, nfa), reverse, nfa);
+
+        case NODE_ALT: {
+            int left = compile_node(nodes, node->left, next, reverse, nfa);
+            int right = compile_node(nodes, node->right, next, reverse, nfa);
+            return left < 0 || right < 0 ? -1 : nfa_add(nfa, NFA_SPLIT, left, right, -1);
+        }
+
+        case NODE_REPEAT: {
+            int tail = next;
+
+            if (node->max == REPEAT_INFINITE) {
+                // loop state first, its body is compiled to come back to it
+                int loop = nfa_add(nfa, NFA_SPLIT, -1, next, -1);
+                if (loop < 0) {
+                    return -1;
+                }
+
+                int body = compile_node(nodes, node->left, loop, reverse, nfa);
+                if (body < 0) {
+                    return -1;
+                }
+
+                nfa->states[loop].out = body;
+                tail = loop;
+
+            } else {
+                for (int i = 0; i < node->max - node->min && tail >= 0; ++i) {
+                    int body = compile_node(nodes, node->left, tail, reverse, nfa);
+                    tail = body < 0 ? -1 : nfa_add(nfa, NFA_SPLIT, body, next, -1);
+                }
+            }
+
+            for (int i = 0; i < node->min && tail >= 0; ++i) {
+                tail = compile_node(nodes, node->left, tail, reverse, nfa);
+            }
+
+            return tail;
+        }
+    }
+
+    return -1;
+}
+
+static bool build_nfa(const node_t *nodes, int root, bool reverse, nfa_t *nfa) {
+    int match = nfa_add(nfa, NFA_MATCH, -1, -1, -1);
+    nfa->start = compile_node(nodes, root, match, reverse, nfa);
+
+    return nfa->start >= 0;
+}
+
+/* splits the bytes into classes that no set can tell apart */
+static void build_byte_classes(ere_t *ere) {
+    memset(ere->byte_class, 0, sizeof(ere->byte_class));
+    int num_classes = 1;
+
+    for (int s = 0; s < ere->num_sets; ++s) {
+        int split[2][256];
+        memset(split, -1, sizeof(split));
+        int count = 0;
+
+        for (int c = 0; c < 256; ++c) {
+            int in = charset_has(&ere->sets[s], (unsigned char) c);
+            int old = ere->byte_class[c];
+
+            if (split[in][old] < 0) {
+                split[in][old] = count++;
+            }
+            ere->byte_class[c] = (unsigned char) split[in][old];
+        }
+
+        num_classes = count;
+    }
+
+    ere->num_classes = num_classes;
+    for (int c = 255; c >= 0; --c) {
+        ere->class_byte[ere->byte_class[c]] = (unsigned char) c;
+    }
+}
+
+/* - lazy DFA ---------------------------------------------------------------- */
+
+/* DFA state: a sorted set of NFA states and its lazily filled transitions */
+typedef struct {
+    int *set;
+    int count;
+    bool match;
+    bool match_eol;
+    bool dead;
+    int *next;
+} dfa_state_t;
+
+typedef struct {
+    const ere_t *ere;
+    const nfa_t *nfa;
+    bool unanchored;
+
+    dfa_state_t *states;
+    int num_states;
+    int *table;
+    int start[2];
+    bool empty_line_match;
+    unsigned long flushes;
+
+    int *stack;
+    unsigned int *mark;
+    unsigned int generation;
+    int *buffer;
+    int count;
+} dfa_t;
+
+/* per-thread DFAs: unanchored forward, unanchored reverse and anchored forward */
+typedef struct {
+    dfa_t forward;
+    dfa_t reverse;
+    dfa_t anchored;
+} dfa_cache_t;
+
+/* an empty line is at both ends at once, so every assertion holds there */
+static bool match_on_empty_line(dfa_t *dfa) {
+    const nfa_state_t *states = dfa->nfa->states;
+    int top = 0;
+    dfa->generation = 1;
+    dfa->stack[top++] = dfa->nfa->start;
+
+    while (top > 0) {
+        int id = dfa->stack[--top];
+        if (dfa->mark[id] == dfa->generation) {
+            continue;
+        }
+        dfa->mark[id] = dfa->generation;
+
+        switch (states[id].type) {
+            case NFA_MATCH:
+                return true;
+            case NFA_SPLIT:
+                if (states[id].out1 >= 0) {
+                    dfa->stack[top++] = states[id].out1;
+                }
+                dfa->stack[top++] = states[id].out;
+                break;
+            case NFA_BOL:
+            case NFA_EOL:
+                dfa->stack[top++] = states[id].out;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return false;
+}
+
+static bool dfa_init(dfa_t *dfa, const ere_t *ere, const nfa_t *nfa, bool unanchored) {
+    memset(dfa, 0, sizeof(dfa_t));
+    dfa->ere = ere;
+    dfa->nfa = nfa;
+    dfa->unanchored = unanchored;
+    dfa->start[0] = dfa->start[1] = -1;
+
+    dfa->states = (dfa_state_t *) malloc(sizeof(dfa_state_t) * ERE_MAX_DFA_STATES);
+    dfa->table = (int *) malloc(sizeof(int) * HASH_SIZE);
+    dfa->stack = (int *) malloc(sizeof(int) * (2 * nfa->num_states + 2));
+    dfa->mark = (unsigned int *) calloc(nfa->num_states, sizeof(unsigned int));
+    dfa->buffer = (int *) malloc(sizeof(int) * nfa->num_states);
+
+    if (!dfa->states || !dfa->table || !dfa->stack || !dfa->mark || !dfa->buffer) {
+        return false;
+    }
+
+    memset(dfa->table, -1, sizeof(int) * HASH_SIZE);
+    dfa->empty_line_match = match_on_empty_line(dfa);
+    return true;
+}
+
+static void dfa_flush(dfa_t *dfa) {
+    for (int i = 0; i < dfa->num_states; ++i) {
+        free(dfa->states[i].set);
+        free(dfa->states[i].next);
+    }
+
+    dfa->num_states = 0;
+    dfa->start[0] = dfa->start[1] = -1;
+    dfa->flushes += 1;
+    memset(dfa->table, -1, sizeof(int) * HASH_SIZE);
+}
+
+static void dfa_free(dfa_t *dfa) {
+    if (dfa->states != NULL) {
+        dfa_flush(dfa);
+    }
+
+    free(dfa->states);
+    free(dfa->table);
+    free(dfa->stack);
+    free(dfa->mark);
+    free(dfa->buffer);
+}
+
+static void next_generation(dfa_t *dfa) {
+    if (++dfa->generation == 0) {
+        memset(dfa->mark, 0, sizeof(unsigned int) * dfa->nfa->num_states);
+        dfa->generation = 1;
+    }
+}
+
+/* adds the epsilon closure of id to the buffer, keeping only consuming, assertion and match states */
+static void closure_add(dfa_t *dfa, int id, bool at_bol) {
+    const nfa_state_t *states = dfa->nfa->states;
+    int top = 0;
+    dfa->stack[top++] = id;
+
+    while (top > 0) {
+        id = dfa->stack[--top];
+        if (dfa->mark[id] == dfa->generation) {
+            continue;
+        }
+        dfa->mark[id] = dfa->generation;
+
+        switch (states[id].type) {
+            case NFA_SPLIT:
+                if (states[id].out1 >= 0) {
+                    dfa->stack[top++] = states[id].out1;
+                }
+                dfa->stack[top++] = states[id].out;
+                break;
+
+            case NFA_BOL:
+                if (at_bol) {
+                    dfa->stack[top++] = states[id].out;
+                }
+                break;
+
+            default:
+                dfa->buffer[dfa->count++] = id;
+                break;
+        }
+    }
+}
+
+/* checks whether a match is reachable once the end of line assertions hold */
+static bool match_at_eol(dfa_t *dfa, const int *set, int count) {
+    const nfa_state_t *states = dfa->nfa->states;
+    int top = 0;
+    next_generation(dfa);
+
+    for (int i = 0; i < count; ++i) {
+        if (states[set[i]].type == NFA_MATCH) {
+            return true;
+        }
+        if (states[set[i]].type == NFA_EOL) {
+            dfa->stack[top++] = states[set[i]].out;
+        }
+
+        while (top > 0) {
+            int id = dfa->stack[--top];
+            if (dfa->mark[id] == dfa->generation) {
+                continue;
+            }
+            dfa->mark[id] = dfa->generation;
+
+            switch (states[id].type) {
+                case NFA_MATCH:
+                    return true;
+                case NFA_SPLIT:
+                    if (states[id].out1 >= 0) {
+                        dfa->stack[top++] = states[id].out1;
+                    }
+                    dfa->stack[top++] = states[id].out;
+                    break;
+                case NFA_EOL:
+                    dfa->stack[top++] = states[id].out;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    return false;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+static unsigned int hash_set(const int *set, int count) {
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; i < count; ++i) {
+        hash = (hash ^ (unsigned int) set[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/*
+ * finds or creates the DFA state for the NFA states in the buffer
+ * returns: its index; -1 when out of memory
+ */
+static int dfa_intern(dfa_t *dfa) {
+    qsort(dfa->buffer, dfa->count, sizeof(int), compare_ints);
+    unsigned int slot = hash_set(dfa->buffer, dfa->count) & (HASH_SIZE - 1);
+
+    while (dfa->table[slot] >= 0) {
+        dfa_state_t *state = &dfa->states[dfa->table[slot]];
+
+        if (state->count == dfa->count && memcmp(state->set, dfa->buffer, sizeof(int) * dfa->count) == 0) {
+            return dfa->table[slot];
+        }
+
+        slot = (slot + 1) & (HASH_SIZE - 1);
+    }
+
+    if (dfa->num_states == ERE_MAX_DFA_STATES) {
+        dfa_flush(dfa);
+        slot = hash_set(dfa->buffer, dfa->count) & (HASH_SIZE - 1);
+    }
+
+    dfa_state_t *state = &dfa->states[dfa->num_states];
+    state->set = (int *) malloc(sizeof(int) * (dfa->count + 1));
+    state->next = (int *) malloc(sizeof(int) * dfa->ere->num_classes);
+
+    if (!state->set || !state->next) {
+        free(state->set);
+        free(state->next);
+        return -1;
+    }
+
+    memcpy(state->set, dfa->buffer, sizeof(int) * dfa->count);
+    memset(state->next, -1, sizeof(int) * dfa->ere->num_classes);
+    state->count = dfa->count;
+    state->dead = dfa->count == 0;
+    state->match = false;
+
+    for (int i = 0; i < dfa->count; ++i) {
+        if (dfa->nfa->states[dfa->buffer[i]].type == NFA_MATCH) {
+            state->match = true;
+        }
+    }
+
+    state->match_eol = state->match || match_at_eol(dfa, state->set, state->count);
+
+    dfa->table[slot] = dfa->num_states;
+    return dfa->num_states++;
+}
+
+static int dfa_start(dfa_t *dfa, bool at_bol) {
+    if (dfa->start[at_bol] < 0) {
+        next_generation(dfa);
+        dfa->count = 0;
+        closure_add(dfa, dfa->nfa->start, at_bol);
+
+        int state = dfa_intern(dfa);
+        dfa->start[at_bol] = state;
+    }
+
+    return dfa->start[at_bol];
+}
+
+static int dfa_compute(dfa_t *dfa, int from, int byte_class) {
+    const nfa_state_t *states = dfa->nfa->states;
+    unsigned char byte = dfa->ere->class_byte[byte_class];
+    dfa_state_t *state = &dfa->states[from];
+
+    next_generation(dfa);
+    dfa->count = 0;
+
+    for (int i = 0; i < state->count; ++i) {
+        const nfa_state_t *nfa_state = &states[state->set[i]];
+
+        if (nfa_state->type == NFA_SET && charset_has(&dfa->ere->sets[nfa_state->set], byte)) {
+            closure_add(dfa, nfa_state->out, false);
+        }
+    }
+
+    if (dfa->unanchored) {
+        closure_add(dfa, dfa->nfa->start, false);
+    }
+
+    unsigned long flushes = dfa->flushes;
+    int to = dfa_intern(dfa);
+
+    // after a flush the source state no longer exists
+    if (to >= 0 && flushes == dfa->flushes) {
+        dfa->states[from].next[byte_class] = to;
+    }
+
+    return to;
+}
+
+static inline int dfa_next(dfa_t *dfa, int from, unsigned char byte) {
+    int byte_class = dfa->ere->byte_class[byte];
+    int to = dfa->states[from].next[byte_class];
+
+    return to >= 0 ? to : dfa_compute(dfa, from, byte_class);
+}
+
+static void free_cache(void *arg) {
+    dfa_cache_t *cache = (dfa_cache_t *) arg;
+
+    if (cache != NULL) {
+        dfa_free(&cache->forward);
+        dfa_free(&cache->reverse);
+        dfa_free(&cache->anchored);
+        free(cache);
+    }
+}
+
+static dfa_cache_t* get_cache(const ere_t *ere) {
+    dfa_cache_t *cache = (dfa_cache_t *) pthread_getspecific(ere->cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    cache = (dfa_cache_t *) calloc(1, sizeof(dfa_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    if (!dfa_init(&cache->forward, ere, &ere->forward, true)
+        || !dfa_init(&cache->reverse, ere, &ere->reverse, true)
+        || !dfa_init(&cache->anchored, ere, &ere->forward, false)) {
+        free_cache(cache);
+        return NULL;
+    }
+
+    pthread_setspecific(ere->cache_key, cache);
+    return cache;
+}
+
+/* - public interface -------------------------------------------------------- */
+
+bool ere_compile(ere_t *ere, const char *pattern, bool icase, const char **error) {
+    memset(ere, 0, sizeof(ere_t));
+
+    parser_t parser = { (const unsigned char *) pattern, 0, 0, NULL, 0, 0, ere, icase, NULL };
+    int root = parse_alternation(&parser);
+
+    if (root >= 0 && parser.pattern[parser.pos] != '\0') {
+        parser.error = "Unmatched ) or \\)";
+        root = -1;
+    }
+
+    if (root >= 0 && (!build_nfa(parser.nodes, root, false, &ere->forward)
+                      || !build_nfa(parser.nodes, root, true, &ere->reverse))) {
+        parser.error = "Regular expression too big";
+        root = -1;
+    }
+
+    if (root >= 0) {
+        literals_t literals = { parser.nodes, ere->sets, NULL, 0, 0, 0, 0, false };
+        collect_literals(&literals, root);
+        literals_end_run(&literals);
+
+        // without them the index only loses precision, never correctness
+        if (literals.failed) {
+            free(literals.data);
+            literals.data = NULL;
+            literals.count = 0;
+        }
+
+        ere->literals = literals.data;
+        ere->num_literals = literals.count;
+    }
+
+    free(parser.nodes);
+
+    if (root < 0 || pthread_key_create(&ere->cache_key, free_cache) != 0) {
+        free(ere->literals);
+        *error = parser.error != NULL ? parser.error : "Out of memory";
+        free(ere->sets);
+        free(ere->forward.states);
+        free(ere->reverse.states);
+        return false;
+    }
+
+    build_byte_classes(ere);
+    return true;
+}
+
+void ere_free(ere_t *ere) {
+    free_cache(pthread_getspecific(ere->cache_key));
+    pthread_key_delete(ere->cache_key);
+
+    free(ere->sets);
+    free(ere->forward.states);
+    free(ere->reverse.states);
+    free(ere->literals);
+}
+
+/*
+ * leftmost-longest match inside a line known to match: the reverse DFA
+ * finds the leftmost start, the anchored DFA the longest end from there
+ */
+static const char* exact_match(dfa_cache_t *cache, const unsigned char *line, const unsigned char *end,
+                               bool real_line_start, size_t *match_length) {
+    dfa_t *dfa = &cache->reverse;
+    const unsigned char *start = NULL;
+    const unsigned char *pos = end;
+
+    if (line == end && real_line_start && dfa->empty_line_match) {
+        *match_length = 0;
+        return (const char *) line;
+    }
+
+    int state = dfa_start(dfa, true);
+    if (state >= 0 && dfa->states[state].match) {
+        start = pos;
+    }
+
+    while (state >= 0 && pos > line) {
+        state = dfa_next(dfa, state, *--pos);
+        if (state >= 0 && dfa->states[state].match) {
+            start = pos;
+        }
+    }
+
+    if (state >= 0 && real_line_start && dfa->states[state].match_eol) {
+        start = line;
+    }
+
+    if (start == NULL) {
+        *match_length = 0;
+        return (const char *) line;
+    }
+
+    dfa = &cache->anchored;
+    const unsigned char *stop = start;
+    pos = start;
+
+    state = dfa_start(dfa, start == line && real_line_start);
+    while (state >= 0 && !dfa->states[state].dead) {
+        if (dfa->states[state].match) {
+            stop = pos;
+        }
+
+        if (pos == end) {
+            if (dfa->states[state].match_eol) {
+                stop = pos;
+            }
+            break;
+        }
+
+        state = dfa_next(dfa, state, *pos++);
+    }
+
+    *match_length = stop - start;
+    return (const char *) start;
+}
+
+const char* ere_find(const ere_t *ere, const char *text, size_t length, bool line_start,
+                     bool exact, size_t *match_length) {
+    dfa_cache_t *cache = get_cache(ere);
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    dfa_t *dfa = &cache->forward;
+    const unsigned char *pos = (const unsigned char *) text;
+    const unsigned char *end = pos + length;
+    const unsigned char *line = pos;
+    const unsigned char *hit = NULL;
+    bool real_line_start = line_start;
+
+    int state = dfa_start(dfa, line_start);
+    if (state >= 0 && dfa->states[state].match) {
+        hit = pos;
+    }
+
+    while (hit == NULL && state >= 0 && pos < end) {
+        unsigned char c = *pos;
+
+        if (c == '\n') {
+            if (dfa->states[state].match_eol || (pos == line && real_line_start && dfa->empty_line_match)) {
+                hit = pos;
+                break;
+            }
+
+            line = ++pos;
+            real_line_start = true;
+            state = dfa_start(dfa, true);
+
+        } else {
+            state = dfa_next(dfa, state, c);
+            ++pos;
+        }
+
+        if (state >= 0 && dfa->states[state].match) {
+            hit = pos;
+        }
+    }
+
+    // the last line has no newline, but only if anything of it is left
+    if (hit == NULL && state >= 0 && pos == end && (line < end || !line_start)
+        && dfa->states[state].match_eol) {
+        hit = end;
+    }
+
+    if (hit == NULL) {
+        return NULL;
+    }
+
+    if (!exact) {
+        *match_length = 0;
+        return (const char *) hit;
+    }
+
+    const unsigned char *line_end = memchr(hit, '\n', end - hit);
+    return exact_match(cache, line, line_end != NULL ? line_end : end, real_line_start, match_length);
+}
@@ -0,0 +1,84 @@
+#ifndef __ERE_H__
+#define __ERE_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* upper bound of cached DFA states per thread and direction, the cache is flushed when full */
+#define ERE_MAX_DFA_STATES 4096
+/* upper bound of NFA states, protects against huge {m,n} expansions */
+#define ERE_MAX_NFA_STATES 100000
+
+/* 256-bit byte set */
+typedef struct {
+    uint64_t bits[4];
+} charset_t;
+
+typedef enum {
+    NFA_SET,    /* consumes one byte from the set */
+    NFA_SPLIT,  /* epsilon to out and, if set, out1 */
+    NFA_BOL,    /* epsilon allowed only at the start of a line */
+    NFA_EOL,    /* epsilon allowed only at the end of a line */
+    NFA_MATCH
+} nfa_type_t;
+
+typedef struct {
+    nfa_type_t type;
+    int out;
+    int out1;
+    int set;
+} nfa_state_t;
+
+/* Thompson NFA */
+typedef struct {
+    nfa_state_t *states;
+    int num_states;
+    int capacity;
+    int start;
+} nfa_t;
+
+/*
+ * Compiled extended regular expression. The NFAs are immutable after
+ * compilation; every thread lazily builds its own DFA caches on top of them.
+ */
+typedef struct {
+    charset_t *sets;
+    int num_sets;
+
+    nfa_t forward;
+    nfa_t reverse;
+
+    unsigned char byte_class[256];
+    unsigned char class_byte[256];
+    int num_classes;
+
+    pthread_key_t cache_key;
+
+    /* byte runs, folded to lowercase and separated by '\0', that every match contains */
+    char *literals;
+    int num_literals;
+} ere_t;
+
+/*
+ * Parses and compiles the pattern, with icase every set also holds the other
+ * case of its ASCII letters
+ * returns: true on success; false and a message in *error on a syntax error
+ */
+bool ere_compile(ere_t *ere, const char *pattern, bool icase, const char **error);
+
+/* frees all memory of the compiled expression and the calling thread's caches */
+void ere_free(ere_t *ere);
+
+/*
+ * Finds the first line in text containing a match. text must not start in
+ * the middle of a line unless line_start is false. With exact set the
+ * leftmost-longest match of that line is returned, otherwise only some
+ * position inside the matching line with *match_length 0.
+ * returns: pointer to the match; NULL if no line matches
+ */
+const char* ere_find(const ere_t *ere, const char *text, size_t length, bool line_start,
+                     bool exact, size_t *match_length);
+
+#endif /* __ERE_H__ */
@@ -0,0 +1,25 @@
+#ifndef __FOLD_H__
+#define __FOLD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* case-insensitive matching folds ASCII letters only, other bytes are compared as they are */
+
+/* returns: lowercase c for an ASCII letter, c otherwise */
+static inline unsigned char fold_byte(unsigned char c) {
+    return (unsigned char) (c - 'A') < 26 ? c | 0x20 : c;
+}
+
+/* returns: true if text folds to the already folded pattern */
+static inline bool fold_equal(const unsigned char *text, const unsigned char *folded, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (fold_byte(text[i]) != folded[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* __FOLD_H__ */
@@ -0,0 +1,113 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define DEFAULT_MB 256
+#define DEFAULT_LINE_LENGTH 120
+#define DEFAULT_DENSITY 1.0
+#define DEFAULT_ALPHABET "abcdefghijklmnopqrstuvwxyz0123456789"
+#define MB (1024 * 1024)
+#define MAX_WORD 10
+
+/* phrases the benchmark searches for, a line holding one is a match */
+static const char *markers[] = {
+    "ERROR",
+    "timeout=",
+    "session-expired",
+    "connection refused",
+    "disk full"
+};
+
+static const char *levels[] = { "INFO", "WARN", "DEBUG", "TRACE" };
+static const char *components[] = { "http", "db", "auth", "cache", "queue", "scheduler" };
+
+/* appends one line of about line_length bytes to the buffer, returns its length */
+static size_t make_line(char *line, size_t line_length, double density, const char *alphabet, size_t symbols,
+                        unsigned int *x) {
+    unsigned int seconds = bench_random(x) % 86400;
+    size_t length = (size_t) sprintf(line, "2024-03-%02u %02u:%02u:%02u.%03u %s %s[%u]: ",
+                                     1 + bench_random(x) % 28, seconds / 3600, seconds / 60 % 60, seconds % 60,
+                                     bench_random(x) % 1000, levels[bench_random(x) % 4],
+                                     components[bench_random(x) % 6], 1000 + bench_random(x) % 9000);
+
+    // the marker goes at a random word of the message
+    bool marked = bench_random(x) % 10000 < density * 100;
+    size_t marker_at = length + bench_random(x) % (line_length > length ? line_length - length : 1);
+
+    while (length < line_length) {
+        if (marked && length >= marker_at) {
+            const char *marker = markers[bench_random(x) % (sizeof(markers) / sizeof(markers[0]))];
+            length += (size_t) sprintf(line + length, "%s", marker);
+
+            if (marker[strlen(marker) - 1] == '=') {
+                length += (size_t) sprintf(line + length, "%u", bench_random(x) % 10000);
+            }
+
+            line[length++] = ' ';
+            marked = false;
+            continue;
+        }
+
+        size_t word = 1 + bench_random(x) % MAX_WORD;
+        for (size_t i = 0; i < word; ++i) {
+            line[length++] = alphabet[bench_random(x) % symbols];
+        }
+
+        line[length++] = bench_random(x) % 8 == 0 ? '=' : ' ';
+    }
+
+    if (marked) {
+        length += (size_t) sprintf(line + length, "%s ", markers[0]);
+    }
+
+    line[length - 1] = '\n';
+    return length;
+}
+
+/*
+ * CORPUS GENERATOR
+ * - usage: gen_corpus [megabytes] [line length] [match density %] [alphabet]
+ * - writes log-like lines to stdout, the same arguments always give the same text;
+ *   density is the share of lines holding one of the phrases bench_grep searches for
+ */
+int main(int argc, char *argv[]) {
+    size_t size = (size_t) (argc > 1 ? atoi(argv[1]) : DEFAULT_MB) * MB;
+    size_t line_length = argc > 2 ? (size_t) atoi(argv[2]) : DEFAULT_LINE_LENGTH;
+    double density = argc > 3 ? atof(argv[3]) : DEFAULT_DENSITY;
+    const char *alphabet = argc > 4 ? argv[4] : DEFAULT_ALPHABET;
+    size_t symbols = strlen(alphabet);
+
+    if (line_length < 1 || line_length > 1 << 20 || density < 0 || density > 100 || symbols == 0
+        || strchr(alphabet, '\n') != NULL) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return EXIT_FAILURE;
+    }
+
+    // a line never exceeds its length by more than one word, a marker and the prefix
+    char *line = (char *) malloc(line_length + 256);
+    if (!line) {
+        fprintf(stderr, "Could not allocate line.\n");
+        return EXIT_FAILURE;
+    }
+
+    unsigned int x = 12345;
+    size_t written = 0;
+
+    while (written < size) {
+        size_t length = make_line(line, line_length, density, alphabet, symbols, &x);
+
+        if (fwrite(line, 1, length, stdout) != length) {
+            fprintf(stderr, "Could not write corpus.\n");
+            free(line);
+            return EXIT_FAILURE;
+        }
+
+        written += length;
+    }
+
+    free(line);
+    return EXIT_SUCCESS;
+}
@@ -1,109 +1,295 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <errno.h>
-
-#define BUFFER_SIZE 1024
-#define COLOR_START "\033[01;31m\033[K"
-#define COLOR_END "\033[m\033[K"
+#include <string.h>
+#include <unistd.h>
+
+#include "aho.h"
+#include "approx.h"
+#include "ere.h"
+#include "literal.h"
+#include "search.h"
+#include "trigram.h"
+#include "walk.h"
+
+/* Compiled -E pattern and whether exact match bounds are needed */
+typedef struct {
+    ere_t ere;
+    bool exact;
+} regex_matcher_t;
+
+/* Compiled --max-errors pattern and whether exact match bounds are needed */
+typedef struct {
+    approx_t approx;
+    bool exact;
+} approx_matcher_t;
+
+/* Automaton of the -f patterns and whether exact match bounds are needed */
+typedef struct {
+    aho_t aho;
+    bool exact;
+} patterns_matcher_t;
+
+/* Patterns read from a -f file */
+typedef struct {
+    char *data;
+    const char **patterns;
+    size_t *lengths;
+    size_t count;
+} pattern_list_t;
+
+/* Literals known to occur in every matching line, used to skip blocks of an index */
+typedef struct {
+    const char *const *literals;
+    const size_t *lengths;
+    size_t count;
+    bool any;           /* one of the literals is enough, otherwise all of them are needed */
+} required_t;
+
+/* Command line options */
+typedef struct {
+    bool regex;
+    bool coloring;
+    bool icase;
+    bool recursive;
+    bool build_index;
+    bool use_index;
+    output_mode_t mode;
+    int threads;        /* 0 when not given */
+    int max_errors;     /* -1 for exact matching */
+    const char *pattern;
+    const char *patterns_file;
+    const char *filename;
+} options_t;
+
+/* Parses [OPTIONS] PATTERN [FILE] or [OPTIONS] -f FILE [FILE], returns EXIT_SUCCESS or EXIT_FAILURE */
+int parse_options(int argc, char *argv[], options_t *options);
 
 /* Searches a provided pattern in file and prints out lines if found */
-void search(FILE *file, const char *pattern, bool coloring, bool *found);
+void search(FILE *file, const options_t *options, bool *found);
 
 /* Searches a provided regex pattern in file and prints out lines if found */
-void search_with_regex(FILE *file, const char *pattern, bool *found);
+void search_with_regex(FILE *file, const options_t *options, bool *found);
+
+/* Searches lines within options->max_errors edits of the pattern in file and prints them out */
+void search_approximate(FILE *file, const options_t *options, bool *found);
+
+/* Searches all patterns of the list in file at once and prints out lines if found */
+void search_with_patterns(FILE *file, const options_t *options, const pattern_list_t *list, bool *found);
+
+/* Reads one pattern per line, returns EXIT_SUCCESS or EXIT_FAILURE */
+int read_patterns(const char *filename, pattern_list_t *list);
+
+/* Joins the patterns into one alternation, returns NULL when out of memory */
+char* join_patterns(const pattern_list_t *list);
+
+/* Searches the file, or the tree named by options with -r; required may be NULL */
+bool run_search(const search_t *search, FILE *file, const options_t *options, const required_t *required);
+
+/* Searches only the blocks of the indexed file that may contain the required literals */
+bool search_indexed(const search_t *search, FILE *file, const options_t *options,
+                    const required_t *required, writer_t *out);
 
 /* Compares two strings, true if strings are identical, false otherwise */
 bool string_compare(const char* first_str, const char* second_str);
 
 int main(int argc, char *argv[]) {
-    FILE *file = NULL;
-    char *pattern = NULL;
-    bool regex = false;
-    bool coloring = false;
-
-    switch (argc) {
-        case 1:
-            fprintf(stderr, "Provide command line arguments.\n");
+    options_t options = { false, false, false, false, false, false, OUTPUT_LINES, 0, -1, NULL, NULL, NULL };
+
+    if (parse_options(argc, argv, &options) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    // a tree or an index build uses all cores unless told otherwise
+    if (options.threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        options.threads = (options.recursive || options.build_index) && cores > 1 ? (int) cores : 1;
+    }
+
+    if (options.build_index) {
+        const char *error = NULL;
+
+        if (!trigram_build(options.filename, options.threads, &error)) {
+            fprintf(stderr, "%s.\n", error);
             return EXIT_FAILURE;
+        }
 
-        case 2:
-            file = stdin;
-            pattern = argv[1];
-            break;
+        return EXIT_SUCCESS;
+    }
+
+    FILE *file = stdin;
+
+    if (options.recursive) {
+        file = NULL;
 
-        case 3:
-            if (string_compare(argv[1], "-E")) {
-                regex = true;
-                file = stdin;
-                pattern = argv[2];
+    } else if (options.filename != NULL) {
+        file = fopen(options.filename, "r");
 
-            } else if (string_compare(argv[1], "--color=always")) {
-                coloring = true;
-                file = stdin;
-                pattern = argv[2];
+        if (file == NULL) {
+            fprintf(stderr, "Could not open file.\n");
+            return errno;
+        }
+    }
+
+    bool found = false;
+    pattern_list_t list = { NULL, NULL, NULL, 0 };
+
+    if (options.patterns_file != NULL) {
+        if (read_patterns(options.patterns_file, &list) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+
+        // an empty list matches nothing, as an alternation it would match everything
+        if (options.regex && list.count > 0) {
+            char *joined = join_patterns(&list);
+
+            if (joined != NULL) {
+                options.pattern = joined;
+                search_with_regex(file, &options, &found);
+                free(joined);
 
             } else {
-                file = fopen(argv[2], "r");
+                fprintf(stderr, "Out of memory.\n");
+            }
+
+        } else {
+            search_with_patterns(file, &options, &list, &found);
+        }
+
+        free(list.data);
+        free(list.patterns);
+        free(list.lengths);
+
+    } else if (options.max_errors >= 0) {
+        search_approximate(file, &options, &found);
+
+    } else if (options.regex) {
+        search_with_regex(file, &options, &found);
+
+    } else {
+        search(file, &options, &found);
+    }
+
+    if (file != stdin && file != NULL && fclose(file) != EXIT_SUCCESS) {
+        fprintf(stderr, "Could not close file.\n");
+        return errno;
+    }
+
+    int ret = found ? EXIT_SUCCESS : EXIT_FAILURE;
+    return ret;
+}
+
+int parse_options(int argc, char *argv[], options_t *options) {
+    if (argc == 1) {
+        fprintf(stderr, "Provide command line arguments.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+
+        if (string_compare(arg, "-E")) {
+            options->regex = true;
+
+        } else if (string_compare(arg, "-i")) {
+            options->icase = true;
+
+        } else if (string_compare(arg, "-r")) {
+            options->recursive = true;
 
-                if (file == NULL) {
-                    fprintf(stderr, "Could not open file.\n");
-                    return errno;
-                }
+        } else if (string_compare(arg, "-c") || string_compare(arg, "-l") || string_compare(arg, "-q")) {
+            // the mode that prints less wins, like -q overrides -l and -l overrides -c
+            output_mode_t mode = arg[1] == 'c' ? OUTPUT_COUNT : (arg[1] == 'l' ? OUTPUT_FILES : OUTPUT_QUIET);
+            options->mode = mode > options->mode ? mode : options->mode;
 
-                pattern = argv[1];
+        } else if (string_compare(arg, "--build-index")) {
+            options->build_index = true;
+
+        } else if (string_compare(arg, "--index")) {
+            options->use_index = true;
+
+        } else if (string_compare(arg, "--color=always")) {
+            options->coloring = true;
+
+        } else if (strncmp(arg, "--max-errors=", 13) == 0) {
+            char *rest = NULL;
+            long errors = strtol(arg + 13, &rest, 10);
+
+            if (rest == arg + 13 || *rest != '\0' || errors < 0 || errors > APPROX_MAX_ERRORS) {
+                fprintf(stderr, "Invalid number of errors, use 0 to %d.\n", APPROX_MAX_ERRORS);
+                return EXIT_FAILURE;
             }
 
-            break;
+            options->max_errors = (int) errors;
 
-        case 4:
-            file = fopen(argv[3], "r");
+        } else if (arg[0] == '-' && arg[1] == 'f') {
+            options->patterns_file = arg[2] != '\0' ? arg + 2 : (i + 1 < argc ? argv[++i] : NULL);
 
-            if (file == NULL) {
-                fprintf(stderr, "Could not open file.\n");
-                return errno;
+            if (options->patterns_file == NULL) {
+                fprintf(stderr, "Provide a pattern file.\n");
+                return EXIT_FAILURE;
             }
 
-            if (string_compare(argv[1], "-E")) {
-                regex = true;
+        } else if (arg[0] == '-' && arg[1] == 'j') {
+            const char *value = arg[2] != '\0' ? arg + 2 : (i + 1 < argc ? argv[++i] : "");
+            options->threads = atoi(value);
 
-            } else if (string_compare(argv[1], "--color=always")) {
-                coloring = true;
+            if (options->threads < 1) {
+                fprintf(stderr, "Invalid number of threads.\n");
+                return EXIT_FAILURE;
             }
 
-            pattern = argv[2];
-            break;
+        } else if (options->pattern == NULL && options->patterns_file == NULL && !options->build_index) {
+            options->pattern = arg;
+
+        } else if (options->filename == NULL) {
+            options->filename = arg;
 
-        default:
+        } else {
             fprintf(stderr, "Too many command line arguments.\n");
             return EXIT_FAILURE;
+        }
     }
 
-    bool found = false;
+    if (options->pattern != NULL && options->patterns_file != NULL) {
+        // the pattern was taken before -f appeared, it is the file name
+        if (options->filename != NULL) {
+            fprintf(stderr, "Too many command line arguments.\n");
+            return EXIT_FAILURE;
+        }
 
-    char pattern_buffer[BUFFER_SIZE];
-    int i = 0;
-    while (pattern[i] != '\0') {
-        pattern_buffer[i] = pattern[i];
-        i += 1;
+        options->filename = options->pattern;
+        options->pattern = NULL;
     }
-    pattern_buffer[i] = '\0';
-    pattern = pattern_buffer;
-    
-    if (regex) {
-        search_with_regex(file, pattern, &found);
 
-    } else {
-        search(file, pattern, coloring, &found);
+    if (options->build_index) {
+        if (options->filename == NULL || options->pattern != NULL || options->patterns_file != NULL) {
+            fprintf(stderr, "--build-index takes only the file to index.\n");
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
     }
 
-    if (file != stdin && fclose(file) != EXIT_SUCCESS) {
-        fprintf(stderr, "Could not close file.\n");
-        return errno;
+    if (options->use_index && (options->recursive || options->filename == NULL)) {
+        fprintf(stderr, "--index works with a single named file only.\n");
+        return EXIT_FAILURE;
     }
 
-    int ret = found ? EXIT_SUCCESS : EXIT_FAILURE;
-    return ret;
+    if (options->pattern == NULL && options->patterns_file == NULL) {
+        fprintf(stderr, "Provide a pattern.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (options->max_errors >= 0 && (options->regex || options->patterns_file != NULL)) {
+        fprintf(stderr, "--max-errors works with a single fixed pattern only.\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
 }
 
 bool string_compare(const char* first_str, const char* second_str) {
@@ -126,261 +312,290 @@ bool string_compare(const char* first_str, const char* second_str) {
     return res;
 }
 
-void search(FILE *file, const char *pattern, bool coloring, bool *found) {
-    char buffer[BUFFER_SIZE];
-    
-    while (fgets(buffer, BUFFER_SIZE, file) != NULL) {
-        char c = 0;
-
-        bool in_pattern = false;
-        bool pattern_found = false;
-        int pattern_index = 0;
-
-        int color_indices[BUFFER_SIZE] = { 0 };
-        int color_index = 0;
-
-        for (int i = 0; buffer[i] != '\0'; ++i) {   
-            c = buffer[i];
-
-            if (!in_pattern) {
-                if (c == pattern[pattern_index]) {
-                    in_pattern = true;
-                    ++pattern_index;
-                    color_indices[color_index++] = i;
-
-                    // Single - letter pattern
-                    if (pattern[pattern_index] == '\0') { 
-                        color_indices[color_index++] = i;
-                        pattern_found = true;
-                        in_pattern = false;
-                        pattern_index = 0;
-                    }
-                }
-
-            } else if (in_pattern && c == pattern[pattern_index]) {
-                ++pattern_index;
-
-                if (pattern[pattern_index] == '\0') {
-                    color_indices[color_index++] = i;
-                    pattern_found = true;
-                    in_pattern = false;
-                    pattern_index = 0;
-                }
-
-            } else if (in_pattern && c != pattern[pattern_index]) {
-                pattern_index = 0;
-                in_pattern = false;
-                
-                // If the wrong letter is also the first letter of pattern
-                if (c == pattern[pattern_index]) {
-                    in_pattern = true;
-                    ++pattern_index;
-                    color_indices[color_index++] = i;
-                }
-            } 
-        }
+bool run_search(const search_t *matcher, FILE *file, const options_t *options, const required_t *required) {
+    search_t search = *matcher;
+    search.mode = options->mode;
 
-        if (pattern_found) {
-            *found = true;
-            int color_index = 0;
-
-            for (int i = 0; buffer[i] != '\0'; ++i) {
-                if (coloring) {
-                    if (color_indices[color_index] == i) {
-                        // Single - letter pattern
-                        if (color_indices[color_index] == color_indices[color_index + 1]) {
-                            printf(COLOR_START);
-                            printf("%c", buffer[i]);
-                            printf(COLOR_END);
-
-                            color_index += 2;
-                        } 
-
-                        // Otherwise
-                        else {
-                            if (color_index % 2 == 0) {
-                                printf(COLOR_START);
-                                printf("%c", buffer[i]); 
-
-                            } else {
-                                printf("%c", buffer[i]); 
-                                printf(COLOR_END);
-                            }
-
-                            ++color_index;
-                        }
-
-                    } else {
-                       printf("%c", buffer[i]); 
-                    }
-
-                } else {
-                    printf("%c", buffer[i]);
-                }
-            }
-        }
+    if (search.mode == OUTPUT_FILES) {
+        search.label = options->filename != NULL ? options->filename : "(standard input)";
+    }
+
+    writer_t out;
+    writer_init(&out, STDOUT_FILENO);
 
-        pattern_found = false;
+    bool found = false;
+
+    if (options->recursive) {
+        found = search_tree(&search, options->filename, &out);
+
+    } else if (options->use_index) {
+        found = search_indexed(&search, file, options, required, &out);
+
+    } else {
+        found = search_file(&search, file, &out);
     }
+
+    if (!writer_flush(&out)) {
+        fprintf(stderr, "Could not write output.\n");
+    }
+
+    writer_free(&out);
+    return found;
 }
 
-void search_with_regex(FILE *file, const char *pattern, bool *found) {
-    char regex = 0;
-    char regex_char = 0;
-    int regex_position = 0;
-
-    char string_without_regex[BUFFER_SIZE];
-    int index = 0;
-
-    for (int i = 0; pattern[i] != '\0'; ++i) {
-        if (pattern[i] == '*' 
-            || pattern[i] == '?' 
-            || pattern[i] == '+') 
-        {
-            regex = pattern[i];
-            regex_char = pattern[i - 1];
-            regex_position = i - 1;
+bool search_indexed(const search_t *search, FILE *file, const options_t *options,
+                    const required_t *required, writer_t *out) {
+    trigram_index_t index;
+
+    if (!trigram_load(&index, options->filename)) {
+        fprintf(stderr, "Could not read the index, searching the whole file.\n");
+        return search_file(search, file, out);
+    }
+
+    bool *candidates = (bool *) malloc(index.num_blocks + 1);
+    bool *matching = (bool *) malloc(index.num_blocks + 1);
+
+    if (candidates == NULL || matching == NULL) {
+        free(candidates);
+        free(matching);
+        trigram_free(&index);
+        return search_file(search, file, out);
+    }
+
+    // with alternatives a block is needed if any of them may occur in it
+    bool any = required != NULL && required->any;
+    memset(candidates, !any, index.num_blocks);
+
+    for (size_t i = 0; required != NULL && i < required->count; ++i) {
+        if (any) {
+            memset(matching, true, index.num_blocks);
+            trigram_filter(&index, required->literals[i], required->lengths[i], matching);
+
+            for (uint32_t b = 0; b < index.num_blocks; ++b) {
+                candidates[b] = candidates[b] || matching[b];
+            }
+
         } else {
-            string_without_regex[index++] = pattern[i];
+            trigram_filter(&index, required->literals[i], required->lengths[i], candidates);
         }
     }
 
-    string_without_regex[index] = '\0';
-    char buffer[BUFFER_SIZE];
+    bool found = trigram_search(search, &index, candidates, file, out);
 
-    bool in_pattern = false;
-    bool pattern_found = false;
-    int pattern_index = 0;
+    free(candidates);
+    free(matching);
+    trigram_free(&index);
+    return found;
+}
 
-    char c = 0;
+/* Adapts literal_find() to the search_t interface */
+const char* find_literal(const void *matcher, const char *text, size_t length,
+                         bool line_start, size_t *match_length) {
+    const literal_t *literal = (const literal_t *) matcher;
+    *match_length = literal->length;
 
-    while(fgets(buffer, BUFFER_SIZE, file) != NULL) {
-        if (regex == '?') {
-            for (int i = 0; buffer[i] != '\0'; ++i) {
-                c = buffer[i];
+    return literal_find(literal, text, length);
+}
 
-                if (!in_pattern) {
-                    if (c == string_without_regex[pattern_index]) {
-                        in_pattern = true;
-                        ++pattern_index;
+void search(FILE *file, const options_t *options, bool *found) {
+    literal_t literal;
 
-                    } else if (pattern_index == regex_position) {
-                        ++pattern_index;
-                        --i;
-                    }
+    if (!literal_compile(&literal, options->pattern, strlen(options->pattern), options->icase)) {
+        fprintf(stderr, "Out of memory.\n");
+        return;
+    }
 
-                } else if (in_pattern && c == string_without_regex[pattern_index]) {
-                    ++pattern_index;
+    size_t length = literal.length;
+    required_t required = { &options->pattern, &length, 1, false };
 
-                } else if (in_pattern && c != string_without_regex[pattern_index]) {
-                    if (pattern_index == regex_position) {
-                        ++pattern_index;
-                        --i;
+    search_t search = { find_literal, &literal, options->coloring, options->threads, NULL, OUTPUT_LINES };
+    *found = run_search(&search, file, options, &required);
 
-                    } else {
-                        pattern_index = 0;
-                        in_pattern = false;
-                    }
-                }
+    literal_free(&literal);
+}
 
-                if (string_without_regex[pattern_index] == '\0') {
-                    pattern_index = 0;
-                    pattern_found = true;
-                    break;
-                }
-            }
-        }
+/* Adapts ere_find() to the search_t interface */
+const char* find_regex(const void *matcher, const char *text, size_t length,
+                       bool line_start, size_t *match_length) {
+    const regex_matcher_t *regex = (const regex_matcher_t *) matcher;
 
-        else if (regex == '*') {
-            for (int i = 0; buffer[i] != '\0'; ++i) {
-                c = buffer[i];
-
-                if (!in_pattern) {
-                    if (c == string_without_regex[pattern_index]) {
-                        if (pattern_index == regex_position) {
-                            while (buffer[i + 1] == regex_char) {
-                                ++i;
-                            }
-                        }
-
-                        in_pattern = true;
-                        ++pattern_index;
-
-                    } else if (pattern_index == regex_position) {
-                        ++pattern_index;
-                        --i;
-                    }
-
-                } else if (in_pattern && c == string_without_regex[pattern_index]) {
-                    if (pattern_index == regex_position) {
-                        while (buffer[i + 1] == regex_char) {
-                            ++i;
-                        }
-                    }
-
-                    ++pattern_index;
-
-                } else if (in_pattern && c != string_without_regex[pattern_index]) {
-                    if (pattern_index == regex_position) {
-                        ++pattern_index;
-                        --i;
-
-                    } else {
-                        pattern_index = 0;
-                        in_pattern = false;
-                    }
-                }
-
-                if (string_without_regex[pattern_index] == '\0') {
-                    pattern_index = 0;
-                    pattern_found = true;
-                    break;
-                }
-            }
-        } 
-
-        else if (regex == '+') {
-            for (int i = 0; buffer[i] != '\0'; ++i) {
-                c = buffer[i];
-
-                if (!in_pattern) {
-                    if (c == string_without_regex[pattern_index]) {
-                        if (pattern_index == regex_position) {
-                            while (buffer[i + 1] == regex_char) {
-                                ++i;
-                            }
-                        }
-
-                        in_pattern = true;
-                        ++pattern_index;
-                    } 
-
-                } else if (in_pattern && c == string_without_regex[pattern_index]) {
-                    if (pattern_index == regex_position) {
-                        while (buffer[i + 1] == regex_char) {
-                            ++i;
-                        }
-                    }
-
-                    ++pattern_index;
-
-                } else if (in_pattern && c != string_without_regex[pattern_index]) {
-                    pattern_index = 0;
-                    in_pattern = false;
-                }
-
-                if (string_without_regex[pattern_index] == '\0') {
-                    pattern_index = 0;
-                    pattern_found = true;
-                    break;
-                }
+    return ere_find(&regex->ere, text, length, line_start, regex->exact, match_length);
+}
+
+void search_with_regex(FILE *file, const options_t *options, bool *found) {
+    regex_matcher_t regex;
+    const char *error = NULL;
+
+    if (!ere_compile(&regex.ere, options->pattern, options->icase, &error)) {
+        fprintf(stderr, "%s.\n", error);
+        return;
+    }
+
+    // without highlighting any position inside the matching line is enough
+    regex.exact = options->coloring;
+
+    // the runs of required bytes are stored one after another
+    int count = regex.ere.num_literals;
+    const char **literals = (const char **) malloc(sizeof(const char *) * (count + 1));
+    size_t *lengths = (size_t *) malloc(sizeof(size_t) * (count + 1));
+    required_t required = { literals, lengths, 0, false };
+
+    const char *run = regex.ere.literals;
+    for (int i = 0; literals != NULL && lengths != NULL && i < count; ++i) {
+        literals[i] = run;
+        lengths[i] = strlen(run);
+        run += lengths[i] + 1;
+        required.count += 1;
+    }
+
+    search_t search = { find_regex, &regex, options->coloring, options->threads, NULL, OUTPUT_LINES };
+    *found = run_search(&search, file, options, &required);
+
+    free(literals);
+    free(lengths);
+    ere_free(&regex.ere);
+}
+
+int read_patterns(const char *filename, pattern_list_t *list) {
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL) {
+        fprintf(stderr, "Could not open pattern file.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t size = 0;
+    size_t capacity = 4096;
+    list->data = (char *) malloc(capacity);
+
+    size_t read = 0;
+    while (list->data != NULL && (read = fread(list->data + size, 1, capacity - size, file)) > 0) {
+        size += read;
+
+        if (size == capacity) {
+            capacity *= 2;
+            char *data = (char *) realloc(list->data, capacity);
+            if (data == NULL) {
+                free(list->data);
             }
+            list->data = data;
         }
+    }
 
-        if (pattern_found) {
-            *found = true;
-            printf("%s", buffer);
-            pattern_found = false;
+    fclose(file);
+
+    size_t lines = 0;
+    for (size_t i = 0; list->data != NULL && i < size; ++i) {
+        lines += list->data[i] == '\n';
+    }
+    lines += size > 0 && list->data[size - 1] != '\n';
+
+    list->patterns = (const char **) malloc(sizeof(const char *) * (lines + 1));
+    list->lengths = (size_t *) malloc(sizeof(size_t) * (lines + 1));
+
+    if (list->data == NULL || list->patterns == NULL || list->lengths == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        free(list->data);
+        free(list->patterns);
+        free(list->lengths);
+        return EXIT_FAILURE;
+    }
+
+    const char *pos = list->data;
+    const char *end = list->data + size;
+    list->count = 0;
+
+    while (pos < end) {
+        const char *newline = memchr(pos, '\n', end - pos);
+        const char *stop = newline != NULL ? newline : end;
+
+        list->patterns[list->count] = pos;
+        list->lengths[list->count] = stop - pos;
+        ++list->count;
+
+        pos = stop + 1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+char* join_patterns(const pattern_list_t *list) {
+    size_t length = 1;
+    for (size_t i = 0; i < list->count; ++i) {
+        length += list->lengths[i] + 3;
+    }
+
+    char *joined = (char *) malloc(length);
+    if (joined == NULL) {
+        return NULL;
+    }
+
+    char *pos = joined;
+    for (size_t i = 0; i < list->count; ++i) {
+        if (i > 0) {
+            *pos++ = '|';
         }
+
+        *pos++ = '(';
+        memcpy(pos, list->patterns[i], list->lengths[i]);
+        pos += list->lengths[i];
+        *pos++ = ')';
+    }
+
+    *pos = '\0';
+    return joined;
+}
+
+/* Adapts aho_find() to the search_t interface */
+const char* find_patterns(const void *matcher, const char *text, size_t length,
+                          bool line_start, size_t *match_length) {
+    const patterns_matcher_t *patterns = (const patterns_matcher_t *) matcher;
+
+    return aho_find(&patterns->aho, text, length, patterns->exact, match_length);
+}
+
+void search_with_patterns(FILE *file, const options_t *options, const pattern_list_t *list, bool *found) {
+    patterns_matcher_t patterns;
+
+    if (!aho_build(&patterns.aho, list->patterns, list->lengths, list->count, options->icase)) {
+        fprintf(stderr, "Out of memory.\n");
+        return;
+    }
+
+    // without highlighting any occurrence inside the matching line is enough
+    patterns.exact = options->coloring;
+
+    required_t required = { list->patterns, list->lengths, list->count, true };
+
+    search_t search = { find_patterns, &patterns, options->coloring, options->threads, NULL, OUTPUT_LINES };
+    *found = run_search(&search, file, options, &required);
+
+    aho_free(&patterns.aho);
+}
+
+/* Adapts approx_find() to the search_t interface */
+const char* find_approximate(const void *matcher, const char *text, size_t length,
+                             bool line_start, size_t *match_length) {
+    const approx_matcher_t *approximate = (const approx_matcher_t *) matcher;
+
+    return approx_find(&approximate->approx, text, length, approximate->exact, match_length);
+}
+
+void search_approximate(FILE *file, const options_t *options, bool *found) {
+    approx_matcher_t approximate;
+
+    if (!approx_compile(&approximate.approx, options->pattern, strlen(options->pattern),
+                        options->max_errors, options->icase)) {
+        fprintf(stderr, "Out of memory.\n");
+        return;
     }
+
+    // without highlighting any position inside the matching line is enough
+    approximate.exact = options->coloring;
+
+    // an approximate occurrence need not contain any trigram of the pattern
+    search_t search = { find_approximate, &approximate, options->coloring, options->threads, NULL, OUTPUT_LINES };
+    *found = run_search(&search, file, options, NULL);
+
+    approx_free(&approximate.approx);
 }
@@ -0,0 +1,252 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fold.h"
+#include "literal.h"
+#include "simd.h"
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/*
+ * a long pattern falls back to Two-Way once failed candidates could have
+ * cost more than one comparison per text byte, keeping the worst case linear
+ */
+#define MIN_FALSE_CANDIDATES 64
+
+/*
+ * Computes the maximal suffix of x for the ordering given by reverse and
+ * its period (Crochemore & Perrin, "Two-way string-matching", 1991)
+ */
+static long maximal_suffix(const unsigned char *x, long m, long *period, bool reverse) {
+    long ms = -1;
+    long j = 0;
+    long k = 1;
+    long p = 1;
+
+    while (j + k < m) {
+        unsigned char a = x[j + k];
+        unsigned char b = x[ms + k];
+
+        if (reverse ? a > b : a < b) {
+            j += k;
+            k = 1;
+            p = j - ms;
+
+        } else if (a == b) {
+            if (k != p) {
+                ++k;
+            } else {
+                j += p;
+                k = 1;
+            }
+
+        } else {
+            ms = j;
+            j = ms + 1;
+            k = p = 1;
+        }
+    }
+
+    *period = p;
+    return ms;
+}
+
+static void compile_two_way(literal_t *literal) {
+    const unsigned char *x = literal->pattern;
+    long m = (long) literal->length;
+    long p = 0;
+    long q = 0;
+
+    long i = maximal_suffix(x, m, &p, false);
+    long j = maximal_suffix(x, m, &q, true);
+
+    if (i > j) {
+        literal->critical = i;
+        literal->period = p;
+    } else {
+        literal->critical = j;
+        literal->period = q;
+    }
+
+    literal->periodic = literal->period + literal->critical + 1 <= m
+        && memcmp(x, x + literal->period, literal->critical + 1) == 0;
+
+    if (!literal->periodic) {
+        literal->period = MAX(literal->critical + 1, m - literal->critical - 1) + 1;
+    }
+}
+
+static void compile_horspool(literal_t *literal) {
+    size_t m = literal->length;
+
+    for (int c = 0; c < ALPHABET_SIZE; ++c) {
+        literal->shift[c] = m;
+    }
+
+    for (size_t i = 0; i + 1 < m; ++i) {
+        unsigned char c = literal->pattern[i];
+        literal->shift[c] = m - 1 - i;
+
+        // the folded pattern is lowercase, the uppercase letter shifts the same
+        if (literal->icase && (unsigned char) (c - 'a') < 26) {
+            literal->shift[c ^ 0x20] = m - 1 - i;
+        }
+    }
+}
+
+bool literal_compile(literal_t *literal, const char *pattern, size_t length, bool icase) {
+    literal->pattern = (const unsigned char *) pattern;
+    literal->length = length;
+    literal->two_way = length > LITERAL_SHORT_PATTERN;
+    literal->icase = icase;
+    literal->folded = NULL;
+
+    // both algorithms work unchanged on the folded alphabet
+    if (icase) {
+        literal->folded = (unsigned char *) malloc(length + 1);
+        if (literal->folded == NULL) {
+            return false;
+        }
+
+        for (size_t i = 0; i < length; ++i) {
+            literal->folded[i] = fold_byte((unsigned char) pattern[i]);
+        }
+        literal->pattern = literal->folded;
+    }
+
+    if (literal->two_way) {
+        compile_two_way(literal);
+    } else {
+        compile_horspool(literal);
+    }
+
+    return true;
+}
+
+void literal_free(literal_t *literal) {
+    free(literal->folded);
+    literal->folded = NULL;
+}
+
+/* byte k of the text as the pattern sees it */
+static inline unsigned char text_byte(const unsigned char *y, long k, bool icase) {
+    return icase ? fold_byte(y[k]) : y[k];
+}
+
+static const char* find_horspool(const literal_t *literal, const unsigned char *text, size_t n) {
+    const unsigned char *x = literal->pattern;
+    size_t m = literal->length;
+    unsigned char last = x[m - 1];
+    bool icase = literal->icase;
+
+    size_t j = 0;
+    while (j + m <= n) {
+        unsigned char c = text[j + m - 1];
+
+        if ((icase ? fold_byte(c) : c) == last
+            && (icase ? fold_equal(text + j, x, m - 1) : memcmp(x, text + j, m - 1) == 0)) {
+            return (const char *) text + j;
+        }
+
+        j += literal->shift[c];
+    }
+
+    return NULL;
+}
+
+static const char* find_two_way(const literal_t *literal, const unsigned char *y, long n) {
+    const unsigned char *x = literal->pattern;
+    long m = (long) literal->length;
+    long ell = literal->critical;
+    long per = literal->period;
+    bool icase = literal->icase;
+    long j = 0;
+
+    if (literal->periodic) {
+        long memory = -1;
+
+        while (j <= n - m) {
+            long i = MAX(ell, memory) + 1;
+            while (i < m && x[i] == text_byte(y, i + j, icase)) {
+                ++i;
+            }
+
+            if (i >= m) {
+                i = ell;
+                while (i > memory && x[i] == text_byte(y, i + j, icase)) {
+                    --i;
+                }
+
+                if (i <= memory) {
+                    return (const char *) y + j;
+                }
+
+                j += per;
+                memory = m - per - 1;
+
+            } else {
+                j += i - ell;
+                memory = -1;
+            }
+        }
+
+    } else {
+        while (j <= n - m) {
+            long i = ell + 1;
+            while (i < m && x[i] == text_byte(y, i + j, icase)) {
+                ++i;
+            }
+
+            if (i >= m) {
+                i = ell;
+                while (i >= 0 && x[i] == text_byte(y, i + j, icase)) {
+                    --i;
+                }
+
+                if (i < 0) {
+                    return (const char *) y + j;
+                }
+
+                j += per;
+
+            } else {
+                j += i - ell;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+const char* literal_find(const literal_t *literal, const char *text, size_t length) {
+    if (literal->length == 0) {
+        return text;
+    }
+
+    if (literal->length > length) {
+        return NULL;
+    }
+
+    if (simd_level() != SIMD_NONE) {
+        size_t max_false = literal->two_way
+            ? length / literal->length + MIN_FALSE_CANDIDATES
+            : (size_t) -1;
+        size_t stop = 0;
+
+        const char *match = simd_find((const char *) literal->pattern, literal->length, literal->icase,
+                                      text, length, max_false, &stop);
+
+        if (match != NULL || stop + literal->length > length) {
+            return match;
+        }
+
+        // too many false candidates, finish with the worst-case linear matcher
+        return find_two_way(literal, (const unsigned char *) text + stop, (long) (length - stop));
+    }
+
+    if (literal->two_way) {
+        return find_two_way(literal, (const unsigned char *) text, (long) length);
+    }
+
+    return find_horspool(literal, (const unsigned char *) text, length);
+}
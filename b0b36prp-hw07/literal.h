@@ -0,0 +1,45 @@
+#ifndef __LITERAL_H__
+#define __LITERAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* patterns up to this length use Horspool, longer ones use Two-Way */
+#define LITERAL_SHORT_PATTERN 16
+
+#define ALPHABET_SIZE 256
+
+/* Compiled literal pattern */
+typedef struct {
+    const unsigned char *pattern;
+    size_t length;
+    bool two_way;
+    bool icase;
+    unsigned char *folded;  /* owned lowercase copy of the pattern with icase */
+
+    /* Horspool bad character shifts */
+    size_t shift[ALPHABET_SIZE];
+
+    /* Two-Way critical factorization */
+    long critical;
+    long period;
+    bool periodic;
+} literal_t;
+
+/*
+ * Preprocesses the pattern, which must stay alive while the literal_t is
+ * used; with icase ASCII letters match regardless of case
+ * returns: false when out of memory
+ */
+bool literal_compile(literal_t *literal, const char *pattern, size_t length, bool icase);
+
+/* frees the memory of the compiled pattern */
+void literal_free(literal_t *literal);
+
+/*
+ * Finds the leftmost occurrence of the pattern in text
+ * returns: pointer to the start of the occurrence; NULL if there is none
+ */
+const char* literal_find(const literal_t *literal, const char *text, size_t length);
+
+#endif /* __LITERAL_H__ */
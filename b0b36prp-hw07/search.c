@@ -0,0 +1,429 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "search.h"
+
+/* smallest chunk handed to a thread, smaller ones cost more than they save */
+#define MIN_CHUNK_SIZE (1024 * 1024)
+/* chunks per thread, more of them balance uneven match density better */
+#define CHUNKS_PER_THREAD 4
+/* initial read buffer of unmappable inputs, it grows for longer lines */
+#define STREAM_BUFFER_SIZE (1024 * 1024)
+
+/* One newline-aligned piece of the buffer and its collected output */
+typedef struct search_chunk {
+    const char *start;
+    const char *end;
+    writer_t output;
+    size_t count;
+    bool done;
+} chunk_t;
+
+/* start of the line containing position pos */
+static const char* line_start(const char *buffer, const char *pos) {
+#ifdef __GLIBC__
+    const char *newline = memrchr(buffer, '\n', pos - buffer);
+    return newline != NULL ? newline + 1 : buffer;
+#else
+    while (pos > buffer && pos[-1] != '\n') {
+        --pos;
+    }
+    return pos;
+#endif
+}
+
+/* end of the line containing position pos, the newline is not included */
+static const char* line_end(const char *pos, const char *end) {
+    const char *newline = memchr(pos, '\n', end - pos);
+    return newline != NULL ? newline : end;
+}
+
+/* prints the label, followed by a separator if one is given */
+static void print_label(const search_t *search, char separator, writer_t *out) {
+    if (search->coloring) {
+        writer_puts(out, COLOR_LABEL);
+        writer_puts(out, search->label);
+        writer_puts(out, COLOR_END);
+
+        if (separator != '\0') {
+            writer_puts(out, COLOR_SEPARATOR);
+            writer_putc(out, separator);
+            writer_puts(out, COLOR_END);
+        }
+
+    } else {
+        writer_puts(out, search->label);
+
+        if (separator != '\0') {
+            writer_putc(out, separator);
+        }
+    }
+}
+
+/* prints the line, highlighting every non-overlapping match starting with the first one */
+static void print_line(const search_t *search, const char *start, const char *end,
+                       const char *match, size_t match_length, writer_t *out) {
+    if (search->label != NULL) {
+        print_label(search, ':', out);
+    }
+
+    if (search->coloring) {
+        const char *pos = start;
+
+        while (match != NULL) {
+            const char *from = match + match_length;
+
+            if (match_length > 0) {
+                writer_write(out, pos, match - pos);
+                writer_puts(out, COLOR_START);
+                writer_write(out, match, match_length);
+                writer_puts(out, COLOR_END);
+                pos = from;
+
+            } else if (match < end) {
+                ++from; // empty matches are not highlighted, look further
+
+            } else {
+                break;
+            }
+
+            match = search->find(search->matcher, from, end - from, false, &match_length);
+        }
+
+        start = pos;
+    }
+
+    writer_write(out, start, end - start);
+    writer_putc(out, '\n');
+}
+
+size_t search_buffer(const search_t *search, const char *buffer, size_t length, writer_t *out) {
+    const char *pos = buffer;
+    const char *end = buffer + length;
+    size_t count = 0;
+
+    while (pos < end) {
+        size_t match_length = 0;
+        const char *match = search->find(search->matcher, pos, end - pos, true, &match_length);
+
+        if (match == NULL) {
+            break;
+        }
+
+        const char *start = line_start(pos, match);
+        const char *stop = line_end(match + match_length, end);
+
+        ++count;
+
+        if (search->mode >= OUTPUT_FILES) {
+            break;
+        }
+
+        // counting needs only the end of the line, nothing is formatted
+        if (search->mode == OUTPUT_LINES) {
+            print_line(search, start, stop, match, match_length, out);
+        }
+
+        pos = stop + 1;
+    }
+
+    return count;
+}
+
+void search_report(const search_t *search, size_t count, writer_t *out) {
+    if (search->mode == OUTPUT_COUNT) {
+        char number[32];
+        snprintf(number, sizeof(number), "%zu\n", count);
+
+        if (search->label != NULL) {
+            print_label(search, ':', out);
+        }
+        writer_puts(out, number);
+
+    } else if (search->mode == OUTPUT_FILES && count > 0 && search->label != NULL) {
+        print_label(search, '\0', out);
+        writer_putc(out, '\n');
+    }
+}
+
+static void* search_chunks(void *arg) {
+    search_pool_t *pool = (search_pool_t *) arg;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        while (!pool->quit && pool->next_chunk >= pool->num_chunks) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+
+        if (pool->next_chunk >= pool->num_chunks) {
+            break;
+        }
+
+        chunk_t *chunk = &pool->chunks[pool->next_chunk++];
+        pthread_mutex_unlock(&pool->lock);
+
+        writer_init(&chunk->output, -1);
+
+        // one match is enough for the early stopping modes, later chunks are skipped
+        if (!__atomic_load_n(&pool->stop, __ATOMIC_RELAXED)) {
+            chunk->count = search_buffer(pool->search, chunk->start, chunk->end - chunk->start, &chunk->output);
+
+            if (chunk->count > 0 && pool->search->mode >= OUTPUT_FILES) {
+                __atomic_store_n(&pool->stop, true, __ATOMIC_RELAXED);
+            }
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        chunk->done = true;
+        pthread_cond_broadcast(&pool->chunk_done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* splits the buffer so that every chunk starts right after a newline */
+static int split_chunks(chunk_t *chunks, int max_chunks, const char *buffer, size_t length, size_t chunk_size) {
+    const char *end = buffer + length;
+    const char *pos = buffer;
+    int num_chunks = 0;
+
+    while (pos < end && num_chunks < max_chunks) {
+        const char *stop = end;
+
+        if (num_chunks + 1 < max_chunks && (size_t) (end - pos) > chunk_size) {
+            stop = line_end(pos + chunk_size, end);
+            stop = stop < end ? stop + 1 : end;
+        }
+
+        chunk_t chunk = { pos, stop, { -1, NULL, 0, 0, false }, 0, false };
+        chunks[num_chunks++] = chunk;
+        pos = stop;
+    }
+
+    return num_chunks;
+}
+
+void search_pool_start(search_pool_t *pool, const search_t *search) {
+    memset(pool, 0, sizeof(search_pool_t));
+    pool->search = search;
+
+    int threads = search->threads;
+    if (threads < 2) {
+        return;
+    }
+
+    pool->max_chunks = threads * CHUNKS_PER_THREAD;
+    pool->chunks = (chunk_t *) malloc(sizeof(chunk_t) * pool->max_chunks);
+    pool->workers = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+
+    if (pool->chunks == NULL || pool->workers == NULL) {
+        free(pool->chunks);
+        free(pool->workers);
+        memset(pool, 0, sizeof(search_pool_t));
+        pool->search = search;
+        return;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->chunk_done, NULL);
+
+    while (pool->num_workers < threads
+           && pthread_create(&pool->workers[pool->num_workers], NULL, search_chunks, pool) == 0) {
+        ++pool->num_workers;
+    }
+}
+
+void search_pool_stop(search_pool_t *pool) {
+    if (pool->workers == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_workers; ++i) {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->chunk_done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->chunks);
+    memset(pool, 0, sizeof(search_pool_t));
+}
+
+/* hands the prepared chunks to the workers and emits them in order as soon as each one is finished */
+static size_t run_chunks(search_pool_t *pool, int num_chunks, writer_t *out) {
+    pthread_mutex_lock(&pool->lock);
+    pool->num_chunks = num_chunks;
+    pool->next_chunk = 0;
+    pool->stop = false;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    size_t count = 0;
+    for (int k = 0; k < num_chunks; ++k) {
+        chunk_t *chunk = &pool->chunks[k];
+
+        pthread_mutex_lock(&pool->lock);
+        while (!chunk->done) {
+            pthread_cond_wait(&pool->chunk_done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        // output the chunk could not collect is an error of the whole search
+        writer_write(out, chunk->output.data, chunk->output.length);
+        out->failed = out->failed || chunk->output.failed;
+        writer_free(&chunk->output);
+        count += chunk->count;
+    }
+
+    return count;
+}
+
+size_t search_pool_buffer(search_pool_t *pool, const char *buffer, size_t length, writer_t *out) {
+    size_t chunk_size = pool->max_chunks > 0 ? length / pool->max_chunks + 1 : length;
+
+    if (chunk_size < MIN_CHUNK_SIZE) {
+        chunk_size = MIN_CHUNK_SIZE;
+    }
+
+    if (pool->num_workers == 0 || length <= chunk_size) {
+        return search_buffer(pool->search, buffer, length, out);
+    }
+
+    int num_chunks = split_chunks(pool->chunks, pool->max_chunks, buffer, length, chunk_size);
+    return run_chunks(pool, num_chunks, out);
+}
+
+size_t search_pool_ranges(search_pool_t *pool, const search_range_t *ranges, size_t count, writer_t *out) {
+    size_t matched = 0;
+
+    for (size_t first = 0; first < count && !(matched > 0 && pool->search->mode >= OUTPUT_FILES); ) {
+        if (pool->num_workers == 0) {
+            matched += search_buffer(pool->search, ranges[first].start, ranges[first].length, out);
+            ++first;
+            continue;
+        }
+
+        // ranges are taken a few per thread at a time, which bounds the output held in memory
+        int num_chunks = 0;
+        for (; first < count && num_chunks < pool->max_chunks; ++first) {
+            chunk_t chunk = { ranges[first].start, ranges[first].start + ranges[first].length,
+                              { -1, NULL, 0, 0, false }, 0, false };
+            pool->chunks[num_chunks++] = chunk;
+        }
+
+        matched += run_chunks(pool, num_chunks, out);
+    }
+
+    return matched;
+}
+
+size_t search_buffer_parallel(const search_t *search, const char *buffer, size_t length, writer_t *out) {
+    if (search->threads < 2 || length <= MIN_CHUNK_SIZE) {
+        return search_buffer(search, buffer, length, out);
+    }
+
+    search_pool_t pool;
+    search_pool_start(&pool, search);
+
+    size_t count = search_pool_buffer(&pool, buffer, length, out);
+
+    search_pool_stop(&pool);
+    return count;
+}
+
+/* reads the descriptor in large blocks, searches the complete lines and carries the last partial one over */
+static size_t search_stream(const search_t *search, int fd, writer_t *out) {
+    // the workers live for the whole input, so their matcher caches outlast a refill
+    search_pool_t pool;
+    search_pool_start(&pool, search);
+
+    size_t capacity = STREAM_BUFFER_SIZE;
+    char *buffer = (char *) malloc(capacity);
+    size_t filled = 0;
+    size_t count = 0;
+    bool end = false;
+
+    while (buffer != NULL && !end && !(count > 0 && search->mode >= OUTPUT_FILES)) {
+        // only a partial line is left, a line longer than the buffer doubles it
+        if (filled == capacity) {
+            char *larger = (char *) realloc(buffer, capacity * 2);
+
+            if (larger == NULL) {
+                break;
+            }
+
+            buffer = larger;
+            capacity *= 2;
+        }
+
+        ssize_t got = read(fd, buffer + filled, capacity - filled);
+
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+
+        end = got <= 0;
+        bool drained = got < (ssize_t) (capacity - filled);
+        filled += got > 0 ? (size_t) got : 0;
+
+        size_t complete = end ? filled : (size_t) (line_start(buffer, buffer + filled) - buffer);
+
+        if (complete > 0) {
+            count += search_pool_buffer(&pool, buffer, complete, out);
+            memmove(buffer, buffer + complete, filled - complete);
+            filled -= complete;
+        }
+
+        // the input is not keeping up, show what was found so far
+        if (drained && search->mode == OUTPUT_LINES) {
+            writer_flush(out);
+        }
+    }
+
+    search_pool_stop(&pool);
+    free(buffer);
+    return count;
+}
+
+bool search_file(const search_t *search, FILE *file, writer_t *out) {
+    struct stat info;
+    int fd = fileno(file);
+    size_t count = 0;
+    bool mapped = false;
+
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size_t length = (size_t) info.st_size;
+        char *buffer = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (buffer != MAP_FAILED) {
+            madvise(buffer, length, MADV_SEQUENTIAL);
+            count = search_buffer_parallel(search, buffer, length, out);
+            munmap(buffer, length);
+            mapped = true;
+        }
+    }
+
+    // pipes, terminals and files that cannot be mapped
+    if (!mapped) {
+        count = search_stream(search, fd, out);
+    }
+
+    search_report(search, count, out);
+    return count > 0;
+}
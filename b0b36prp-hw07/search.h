@@ -0,0 +1,117 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "writer.h"
+
+#define COLOR_START "\033[01;31m\033[K"
+#define COLOR_END "\033[m\033[K"
+#define COLOR_LABEL "\033[35m\033[K"
+#define COLOR_SEPARATOR "\033[36m\033[K"
+
+/*
+ * Finds the leftmost match in text, matches never span a newline; line_start
+ * tells whether text begins at the start of a line or in the middle of one
+ * returns: pointer to the match and its length in *match_length; NULL if none
+ */
+typedef const char* (*find_func_t)(const void *matcher, const char *text, size_t length,
+                                   bool line_start, size_t *match_length);
+
+/* What is printed for a searched file, later modes stop earlier */
+typedef enum {
+    OUTPUT_LINES,       /* every matching line */
+    OUTPUT_COUNT,       /* the number of matching lines, no line is formatted */
+    OUTPUT_FILES,       /* the label if anything matches, reading stops at the first match */
+    OUTPUT_QUIET        /* nothing, the whole search stops at the first match */
+} output_mode_t;
+
+/* Compiled search, shared by all input paths */
+typedef struct {
+    find_func_t find;
+    const void *matcher;
+    bool coloring;
+    int threads;
+    const char *label;  /* printed with ':' before every line, NULL for none */
+    output_mode_t mode;
+} search_t;
+
+/*
+ * Runs the matcher over the whole buffer and prints every line containing
+ * a match; line boundaries are only looked up around the matches. Other
+ * modes only count the lines, or stop at the first one.
+ * returns: number of matching lines
+ */
+size_t search_buffer(const search_t *search, const char *buffer, size_t length, writer_t *out);
+
+/* Newline-aligned piece of a buffer */
+typedef struct {
+    const char *start;
+    size_t length;
+} search_range_t;
+
+/*
+ * Search threads kept for a whole input. Matchers keep per-thread state
+ * (the lazy DFA cache of ere_t), which lives only as long as its thread.
+ */
+typedef struct {
+    const search_t *search;
+    pthread_t *workers;
+    int num_workers;    /* 0 when everything runs in the calling thread */
+    struct search_chunk *chunks;
+    int max_chunks;
+    int num_chunks;
+    int next_chunk;
+    bool stop;          /* set once a match is found in a mode that needs only one */
+    bool quit;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t chunk_done;
+} search_pool_t;
+
+/*
+ * Starts search->threads threads for the search; with fewer than two
+ * threads, or when none can be started, the pool searches in the caller
+ */
+void search_pool_start(search_pool_t *pool, const search_t *search);
+
+/* stops and joins the threads of the pool */
+void search_pool_stop(search_pool_t *pool);
+
+/*
+ * Like search_buffer_parallel(), with the threads of the pool
+ * returns: number of matching lines
+ */
+size_t search_pool_buffer(search_pool_t *pool, const char *buffer, size_t length, writer_t *out);
+
+/*
+ * Searches every range as one chunk, the ranges are spread over the threads
+ * of the pool and their output is written in the order of the ranges
+ * returns: number of matching lines
+ */
+size_t search_pool_ranges(search_pool_t *pool, const search_range_t *ranges, size_t count, writer_t *out);
+
+/*
+ * Splits the buffer into newline-aligned chunks searched by search->threads
+ * threads; every chunk collects its output in memory and the chunks are
+ * written in their original order
+ * returns: number of matching lines
+ */
+size_t search_buffer_parallel(const search_t *search, const char *buffer, size_t length, writer_t *out);
+
+/*
+ * Searches the file, regular files are memory-mapped and searched as one
+ * buffer (in parallel with more than one thread), other inputs are read
+ * in large blocks whose complete lines are searched the same way. The count
+ * or name of the file is reported as the mode says.
+ * returns: true if at least one line matched
+ */
+bool search_file(const search_t *search, FILE *file, writer_t *out);
+
+/* prints the per-file result of the count and files modes for count matching lines */
+void search_report(const search_t *search, size_t count, writer_t *out);
+
+#endif /* __SEARCH_H__ */
@@ -0,0 +1,226 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "fold.h"
+#include "simd.h"
+
+#ifdef SIMD_SEARCH
+#include <immintrin.h>
+#endif
+
+#define AVX2_BLOCK 32
+#define SSE2_BLOCK 16
+
+static int detected = -1;
+static int forced = -1;
+
+/* search state shared by the kernels */
+typedef struct {
+    const char *pattern;
+    size_t m;
+    const char *text;
+    size_t n;
+    size_t pos;
+    size_t false_left;
+    bool exhausted;
+    bool icase;
+} scan_t;
+
+simd_level_t simd_level(void) {
+    // search threads may race on the first call, they all store the same value
+    int level = __atomic_load_n(&detected, __ATOMIC_RELAXED);
+
+    if (level < 0) {
+        level = SIMD_NONE;
+#ifdef SIMD_SEARCH
+        level = SIMD_SSE2;
+        if (__builtin_cpu_supports("avx2")) {
+            level = SIMD_AVX2;
+        }
+#endif
+        __atomic_store_n(&detected, level, __ATOMIC_RELAXED);
+    }
+
+    if (forced >= 0 && forced < level) {
+        return (simd_level_t) forced;
+    }
+
+    return (simd_level_t) level;
+}
+
+void simd_force_level(simd_level_t level) {
+    forced = level;
+}
+
+/* checks a candidate whose first and last bytes already match */
+static inline bool verify(scan_t *scan, size_t i) {
+    const unsigned char *text = (const unsigned char *) scan->text + i + 1;
+    const unsigned char *pattern = (const unsigned char *) scan->pattern + 1;
+
+    if (scan->m <= 2 || (scan->icase ? fold_equal(text, pattern, scan->m - 2)
+                                     : memcmp(text, pattern, scan->m - 2) == 0)) {
+        return true;
+    }
+
+    if (scan->false_left == 0) {
+        scan->exhausted = true;
+    } else {
+        scan->false_left -= 1;
+    }
+
+    return false;
+}
+
+/* checks every candidate bit of a block mask, lowest position first */
+static inline const char* verify_mask(scan_t *scan, size_t i, unsigned int mask) {
+    while (mask != 0) {
+        size_t candidate = i + __builtin_ctz(mask);
+
+        if (verify(scan, candidate)) {
+            return scan->text + candidate;
+        }
+
+        if (scan->exhausted) {
+            scan->pos = candidate + 1;
+            return NULL;
+        }
+
+        mask &= mask - 1;
+    }
+
+    return NULL;
+}
+
+static const char* find_scalar(scan_t *scan) {
+    const unsigned char *text = (const unsigned char *) scan->text;
+    unsigned char first = scan->pattern[0];
+    unsigned char last = scan->pattern[scan->m - 1];
+    size_t end = scan->n - scan->m + 1;
+
+    while (scan->pos < end) {
+        size_t i = scan->pos;
+
+        if (scan->icase) {
+            while (i < end && fold_byte(text[i]) != first) {
+                ++i;
+            }
+
+            if (i == end) {
+                break;
+            }
+
+        } else {
+            const unsigned char *found = memchr(text + i, first, end - i);
+            if (found == NULL) {
+                break;
+            }
+
+            i = found - text;
+        }
+
+        scan->pos = i + 1;
+        unsigned char c = text[i + scan->m - 1];
+
+        if ((scan->icase ? fold_byte(c) : c) == last) {
+            if (verify(scan, i)) {
+                return scan->text + i;
+            }
+
+            if (scan->exhausted) {
+                return NULL;
+            }
+        }
+    }
+
+    scan->pos = end;
+    return NULL;
+}
+
+#ifdef SIMD_SEARCH
+/* bits OR-ed into text bytes compared with the pattern byte c, 0x20 folds a letter */
+static inline char case_bits(const scan_t *scan, char c) {
+    return scan->icase && (unsigned char) (c - 'a') < 26 ? 0x20 : 0;
+}
+
+static const char* find_sse2(scan_t *scan) {
+    const __m128i first = _mm_set1_epi8(scan->pattern[0]);
+    const __m128i last = _mm_set1_epi8(scan->pattern[scan->m - 1]);
+    const __m128i first_case = _mm_set1_epi8(case_bits(scan, scan->pattern[0]));
+    const __m128i last_case = _mm_set1_epi8(case_bits(scan, scan->pattern[scan->m - 1]));
+    const char *text = scan->text;
+    size_t i = scan->pos;
+
+    for (; i + scan->m - 1 + SSE2_BLOCK <= scan->n; i += SSE2_BLOCK) {
+        __m128i block_first = _mm_or_si128(_mm_loadu_si128((const __m128i *) (text + i)), first_case);
+        __m128i block_last = _mm_or_si128(_mm_loadu_si128((const __m128i *) (text + i + scan->m - 1)), last_case);
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(eq);
+
+        if (mask != 0) {
+            const char *match = verify_mask(scan, i, mask);
+            if (match != NULL || scan->exhausted) {
+                return match;
+            }
+        }
+    }
+
+    scan->pos = i;
+    return find_scalar(scan);
+}
+
+__attribute__((target("avx2")))
+static const char* find_avx2(scan_t *scan) {
+    const __m256i first = _mm256_set1_epi8(scan->pattern[0]);
+    const __m256i last = _mm256_set1_epi8(scan->pattern[scan->m - 1]);
+    const __m256i first_case = _mm256_set1_epi8(case_bits(scan, scan->pattern[0]));
+    const __m256i last_case = _mm256_set1_epi8(case_bits(scan, scan->pattern[scan->m - 1]));
+    const char *text = scan->text;
+    size_t i = scan->pos;
+
+    for (; i + scan->m - 1 + AVX2_BLOCK <= scan->n; i += AVX2_BLOCK) {
+        __m256i block_first = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (text + i)), first_case);
+        __m256i block_last = _mm256_or_si256(_mm256_loadu_si256((const __m256i *) (text + i + scan->m - 1)),
+                                             last_case);
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(eq);
+
+        if (mask != 0) {
+            const char *match = verify_mask(scan, i, mask);
+            if (match != NULL || scan->exhausted) {
+                return match;
+            }
+        }
+    }
+
+    scan->pos = i;
+    return find_scalar(scan);
+}
+#endif
+
+const char* simd_find(const char *pattern, size_t m, bool icase, const char *text, size_t n,
+                      size_t max_false, size_t *stop) {
+    if (m > n) {
+        *stop = n;
+        return NULL;
+    }
+
+    scan_t scan = { pattern, m, text, n, 0, max_false, false, icase };
+    const char *match = NULL;
+
+    switch (simd_level()) {
+#ifdef SIMD_SEARCH
+        case SIMD_AVX2:
+            match = find_avx2(&scan);
+            break;
+        case SIMD_SSE2:
+            match = find_sse2(&scan);
+            break;
+#endif
+        default:
+            match = find_scalar(&scan);
+            break;
+    }
+
+    *stop = scan.pos;
+    return match;
+}
@@ -0,0 +1,37 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* vector kernels exist only on x86, other targets use the scalar matchers */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SIMD_SEARCH 1
+#endif
+
+typedef enum {
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2
+} simd_level_t;
+
+/* gets the best kernel supported by this CPU, detected once at first use */
+simd_level_t simd_level(void);
+
+/* overrides the detected kernel (benchmarks only), levels above the CPU are clamped */
+void simd_force_level(simd_level_t level);
+
+/*
+ * Finds the leftmost occurrence of pattern (m >= 1) in text. Whole blocks
+ * of text are compared against the first and last pattern bytes, only
+ * positions where both match are verified. With icase the pattern must be
+ * folded to lowercase; letters are compared with 0x20 OR-ed into the text.
+ * Verification stops after max_false failed candidates so the caller can
+ * switch to a worst-case linear matcher; *stop then holds the first
+ * position not yet checked, otherwise it is set past the last candidate.
+ * returns: pointer to the occurrence; NULL if there is none before *stop
+ */
+const char* simd_find(const char *pattern, size_t m, bool icase, const char *text, size_t n,
+                      size_t max_false, size_t *stop);
+
+#endif /* __SIMD_H__ */
@@ -0,0 +1,691 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fold.h"
+#include "trigram.h"
+
+#define MAGIC "TGI2"
+#define NUM_TRIGRAMS (1 << 24)
+/* blocks extracted ahead of the merge, bounds the memory of the pending trigram lists */
+#define LOOKAHEAD_PER_THREAD 4
+
+/* - encoding ---------------------------------------------------------------- */
+
+static size_t encode_varint(unsigned char *out, uint32_t value) {
+    size_t length = 0;
+
+    while (value >= 0x80) {
+        out[length++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+
+    out[length++] = (unsigned char) value;
+    return length;
+}
+
+static uint32_t decode_varint(const unsigned char **pos) {
+    uint32_t value = 0;
+    int shift = 0;
+
+    while (**pos & 0x80) {
+        value |= (uint32_t) (*(*pos)++ & 0x7f) << shift;
+        shift += 7;
+    }
+
+    value |= (uint32_t) *(*pos)++ << shift;
+    return value;
+}
+
+/* FNV-1a */
+static uint64_t hash_bytes(const unsigned char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* - building ---------------------------------------------------------------- */
+
+/* Posting list under construction */
+typedef struct {
+    uint32_t trigram;
+    uint32_t next_block;    /* one past the last block added, gaps are taken from here */
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} posting_t;
+
+typedef struct {
+    uint32_t *slot;         /* trigram -> posting index + 1, 0 if absent */
+    posting_t *postings;
+    uint32_t num_postings;
+    uint32_t capacity;
+    bool failed;
+} builder_t;
+
+/* Distinct trigrams of one block, produced by a worker */
+typedef struct {
+    uint32_t *trigrams;
+    size_t count;
+    bool done;
+} job_t;
+
+/* State shared by the extracting threads and the merging main thread */
+typedef struct {
+    const unsigned char *data;
+    trigram_block_t *blocks;
+    job_t *jobs;
+    uint32_t num_jobs;
+    uint32_t next_job;
+    uint32_t merged;
+    uint32_t lookahead;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} build_t;
+
+static void builder_add(builder_t *builder, uint32_t trigram, uint32_t block) {
+    uint32_t index = builder->slot[trigram];
+
+    if (index == 0) {
+        if (builder->num_postings == builder->capacity) {
+            uint32_t capacity = builder->capacity ? builder->capacity * 2 : 4096;
+            posting_t *postings = (posting_t *) realloc(builder->postings, sizeof(posting_t) * capacity);
+
+            if (postings == NULL) {
+                builder->failed = true;
+                return;
+            }
+
+            builder->postings = postings;
+            builder->capacity = capacity;
+        }
+
+        posting_t posting = { trigram, 0, NULL, 0, 0 };
+        builder->postings[builder->num_postings++] = posting;
+        index = builder->slot[trigram] = builder->num_postings;
+    }
+
+    posting_t *posting = &builder->postings[index - 1];
+
+    if (posting->length + 5 > posting->capacity) {
+        size_t capacity = posting->capacity ? posting->capacity * 2 : 8;
+        unsigned char *data = (unsigned char *) realloc(posting->data, capacity);
+
+        if (data == NULL) {
+            builder->failed = true;
+            return;
+        }
+
+        posting->data = data;
+        posting->capacity = capacity;
+    }
+
+    posting->length += encode_varint(posting->data + posting->length, block - posting->next_block);
+    posting->next_block = block + 1;
+}
+
+/* collects the distinct folded trigrams of one block, seen is a cleared bitmap of all trigrams */
+static bool extract(const unsigned char *data, size_t length, uint64_t *seen, job_t *job) {
+    size_t capacity = 1024;
+    job->trigrams = (uint32_t *) malloc(sizeof(uint32_t) * capacity);
+    job->count = 0;
+
+    uint32_t trigram = 0;
+    int valid = 0;
+
+    for (size_t i = 0; job->trigrams != NULL && i < length; ++i) {
+        if (data[i] == '\n') {
+            valid = 0;
+            continue;
+        }
+
+        trigram = ((trigram << 8) | fold_byte(data[i])) & (NUM_TRIGRAMS - 1);
+
+        if (++valid < 3 || (seen[trigram >> 6] >> (trigram & 63)) & 1) {
+            continue;
+        }
+
+        seen[trigram >> 6] |= (uint64_t) 1 << (trigram & 63);
+
+        if (job->count == capacity) {
+            capacity *= 2;
+            uint32_t *trigrams = (uint32_t *) realloc(job->trigrams, sizeof(uint32_t) * capacity);
+
+            if (trigrams == NULL) {
+                free(job->trigrams);
+            }
+            job->trigrams = trigrams;
+        }
+
+        if (job->trigrams != NULL) {
+            job->trigrams[job->count++] = trigram;
+        }
+    }
+
+    // clear only the bits that were set, the bitmap is reused for the next block
+    for (size_t i = 0; job->trigrams != NULL && i < job->count; ++i) {
+        seen[job->trigrams[i] >> 6] = 0;
+    }
+
+    if (job->trigrams == NULL) {
+        memset(seen, 0, NUM_TRIGRAMS / 8);
+        return false;
+    }
+
+    return true;
+}
+
+static void* extract_jobs(void *arg) {
+    build_t *build = (build_t *) arg;
+    uint64_t *seen = (uint64_t *) calloc(NUM_TRIGRAMS / 64, sizeof(uint64_t));
+
+    pthread_mutex_lock(&build->lock);
+
+    // without a bitmap the jobs are still claimed, their missing lists fail the build
+    while (true) {
+        while (build->next_job < build->num_jobs && build->next_job >= build->merged + build->lookahead) {
+            pthread_cond_wait(&build->changed, &build->lock);
+        }
+
+        if (build->next_job >= build->num_jobs) {
+            break;
+        }
+
+        uint32_t k = build->next_job++;
+        pthread_mutex_unlock(&build->lock);
+
+        trigram_block_t *block = &build->blocks[k];
+        const unsigned char *data = build->data + block->offset;
+
+        if (seen != NULL) {
+            block->hash = hash_bytes(data, block->length);
+            extract(data, block->length, seen, &build->jobs[k]);
+        }
+
+        pthread_mutex_lock(&build->lock);
+        build->jobs[k].done = true;
+        pthread_cond_broadcast(&build->changed);
+    }
+
+    pthread_mutex_unlock(&build->lock);
+    free(seen);
+    return NULL;
+}
+
+/* splits data[start, size) into newline-aligned blocks appended to blocks */
+static uint32_t split_blocks(const unsigned char *data, uint64_t start, uint64_t size,
+                             trigram_block_t *blocks, uint32_t first) {
+    uint32_t count = first;
+
+    while (start < size) {
+        uint64_t stop = size;
+
+        if (size - start > TRIGRAM_BLOCK_SIZE) {
+            const unsigned char *newline = memchr(data + start + TRIGRAM_BLOCK_SIZE, '\n',
+                                                  size - start - TRIGRAM_BLOCK_SIZE);
+            stop = newline != NULL ? (uint64_t) (newline - data) + 1 : size;
+        }
+
+        trigram_block_t block = { start, stop - start, 0 };
+        blocks[count++] = block;
+        start = stop;
+    }
+
+    return count;
+}
+
+/* copies the postings of the first keep blocks of the old index */
+static void keep_postings(builder_t *builder, const trigram_index_t *old, uint32_t keep) {
+    for (uint32_t t = 0; t < old->num_trigrams; ++t) {
+        const unsigned char *pos = old->postings + old->offsets[t];
+        const unsigned char *end = old->postings + old->offsets[t + 1];
+        uint32_t block = 0;
+
+        while (pos < end) {
+            block += decode_varint(&pos);
+
+            if (block >= keep) {
+                break;
+            }
+
+            builder_add(builder, old->trigrams[t], block);
+            block += 1;
+        }
+    }
+}
+
+static bool write_index(const char *filename, const builder_t *builder, const trigram_block_t *blocks,
+                        uint32_t num_blocks, const struct stat *info) {
+    size_t name_length = strlen(filename);
+    char *name = (char *) malloc(name_length + sizeof(TRIGRAM_SUFFIX) + 4);
+    char *temporary = (char *) malloc(name_length + sizeof(TRIGRAM_SUFFIX) + 4);
+
+    if (name == NULL || temporary == NULL) {
+        free(name);
+        free(temporary);
+        return false;
+    }
+
+    sprintf(name, "%s%s", filename, TRIGRAM_SUFFIX);
+    sprintf(temporary, "%s.new", name);
+
+    FILE *out = fopen(temporary, "wb");
+    bool ok = out != NULL;
+
+    uint64_t postings_size = 0;
+    for (uint32_t i = 0; i < builder->num_postings; ++i) {
+        postings_size += builder->postings[i].length;
+    }
+
+    if (ok) {
+        uint32_t num_trigrams = builder->num_postings;
+        uint32_t reserved = 0;
+        uint64_t file_size = (uint64_t) info->st_size;
+        uint64_t inode = (uint64_t) info->st_ino;
+        int64_t mtime[2] = { (int64_t) info->st_mtim.tv_sec, (int64_t) info->st_mtim.tv_nsec };
+
+        ok = fwrite(MAGIC, 1, 4, out) == 4
+            && fwrite(&num_blocks, sizeof(num_blocks), 1, out) == 1
+            && fwrite(&file_size, sizeof(file_size), 1, out) == 1
+            && fwrite(&num_trigrams, sizeof(num_trigrams), 1, out) == 1
+            && fwrite(&reserved, sizeof(reserved), 1, out) == 1
+            && fwrite(&postings_size, sizeof(postings_size), 1, out) == 1
+            && fwrite(&inode, sizeof(inode), 1, out) == 1
+            && fwrite(mtime, sizeof(int64_t), 2, out) == 2
+            && fwrite(blocks, sizeof(trigram_block_t), num_blocks, out) == num_blocks;
+    }
+
+    // the slot table is walked in trigram order, so the dictionary comes out sorted
+    for (uint32_t trigram = 0; ok && trigram < NUM_TRIGRAMS; ++trigram) {
+        if (builder->slot[trigram] != 0) {
+            ok = fwrite(&trigram, sizeof(trigram), 1, out) == 1;
+        }
+    }
+
+    uint64_t offset = 0;
+    for (uint32_t trigram = 0; ok && trigram < NUM_TRIGRAMS; ++trigram) {
+        if (builder->slot[trigram] != 0) {
+            ok = fwrite(&offset, sizeof(offset), 1, out) == 1;
+            offset += builder->postings[builder->slot[trigram] - 1].length;
+        }
+    }
+    ok = ok && fwrite(&offset, sizeof(offset), 1, out) == 1;
+
+    for (uint32_t trigram = 0; ok && trigram < NUM_TRIGRAMS; ++trigram) {
+        if (builder->slot[trigram] != 0) {
+            const posting_t *posting = &builder->postings[builder->slot[trigram] - 1];
+            ok = fwrite(posting->data, 1, posting->length, out) == posting->length;
+        }
+    }
+
+    if (out != NULL && fclose(out) != 0) {
+        ok = false;
+    }
+
+    // readers see either the old or the new index, never a partial one
+    ok = ok && rename(temporary, name) == 0;
+    if (!ok) {
+        remove(temporary);
+    }
+
+    free(name);
+    free(temporary);
+    return ok;
+}
+
+/* extracts the jobs in parallel and merges them in block order */
+static void run_jobs(build_t *build, builder_t *builder, uint32_t first, int threads) {
+    pthread_t *workers = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+    int started = 0;
+
+    while (workers != NULL && started < threads && pthread_create(&workers[started], NULL, extract_jobs, build) == 0) {
+        ++started;
+    }
+
+    if (started == 0) {
+        build->lookahead = build->num_jobs; // no threads available, extract everything here
+        extract_jobs(build);
+    }
+
+    for (uint32_t k = 0; k < build->num_jobs; ++k) {
+        job_t *job = &build->jobs[k];
+
+        pthread_mutex_lock(&build->lock);
+        while (!job->done) {
+            pthread_cond_wait(&build->changed, &build->lock);
+        }
+        pthread_mutex_unlock(&build->lock);
+
+        if (job->trigrams == NULL) {
+            builder->failed = true;
+        }
+
+        for (size_t i = 0; i < job->count && !builder->failed; ++i) {
+            builder_add(builder, job->trigrams[i], first + k);
+        }
+
+        free(job->trigrams);
+        job->trigrams = NULL;
+
+        pthread_mutex_lock(&build->lock);
+        build->merged = k + 1;
+        pthread_cond_broadcast(&build->changed);
+        pthread_mutex_unlock(&build->lock);
+    }
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+}
+
+bool trigram_build(const char *filename, int threads, const char **error) {
+    FILE *file = fopen(filename, "r");
+    struct stat info;
+
+    if (file == NULL || fstat(fileno(file), &info) != 0 || !S_ISREG(info.st_mode)) {
+        *error = "Could not open file";
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+
+    uint64_t size = (uint64_t) info.st_size;
+    const unsigned char *data = NULL;
+
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (data == MAP_FAILED) {
+            *error = "Could not read file";
+            fclose(file);
+            return false;
+        }
+
+        madvise((void *) data, size, MADV_SEQUENTIAL);
+    }
+
+    fclose(file);
+
+    // an appended file keeps all blocks but the last, which may have been partial;
+    // a change anywhere in the kept blocks means a rebuild from scratch
+    trigram_index_t old;
+    uint32_t keep = 0;
+    bool loaded = trigram_load(&old, filename);
+
+    if (loaded && old.file_size <= size && old.num_blocks > 1) {
+        keep = old.num_blocks - 1;
+
+        for (uint32_t b = 0; b < keep; ++b) {
+            const trigram_block_t *block = &old.blocks[b];
+
+            if (hash_bytes(data + block->offset, block->length) != block->hash) {
+                keep = 0;
+                break;
+            }
+        }
+    }
+
+    uint64_t start = keep > 0 ? old.blocks[keep - 1].offset + old.blocks[keep - 1].length : 0;
+    uint32_t max_blocks = keep + (uint32_t) ((size - start) / TRIGRAM_BLOCK_SIZE) + 1;
+
+    trigram_block_t *blocks = (trigram_block_t *) malloc(sizeof(trigram_block_t) * max_blocks);
+    builder_t builder = { (uint32_t *) calloc(NUM_TRIGRAMS, sizeof(uint32_t)), NULL, 0, 0, false };
+
+    bool ok = blocks != NULL && builder.slot != NULL;
+
+    uint32_t num_blocks = 0;
+    if (ok) {
+        if (keep > 0) {
+            memcpy(blocks, old.blocks, sizeof(trigram_block_t) * keep);
+            keep_postings(&builder, &old, keep);
+        }
+
+        num_blocks = split_blocks(data, start, size, blocks, keep);
+    }
+
+    if (loaded) {
+        trigram_free(&old);
+    }
+
+    job_t *jobs = ok ? (job_t *) calloc(num_blocks - keep + 1, sizeof(job_t)) : NULL;
+    ok = ok && jobs != NULL;
+
+    if (ok) {
+        int workers = threads > 1 ? threads : 1;
+        build_t build = { data, blocks + keep, jobs, num_blocks - keep, 0, 0,
+                          (uint32_t) workers * LOOKAHEAD_PER_THREAD };
+        pthread_mutex_init(&build.lock, NULL);
+        pthread_cond_init(&build.changed, NULL);
+
+        run_jobs(&build, &builder, keep, workers);
+
+        pthread_cond_destroy(&build.changed);
+        pthread_mutex_destroy(&build.lock);
+    }
+
+    ok = ok && !builder.failed;
+    if (!ok) {
+        *error = "Out of memory";
+    }
+
+    if (ok && !write_index(filename, &builder, blocks, num_blocks, &info)) {
+        *error = "Could not write index";
+        ok = false;
+    }
+
+    for (uint32_t i = 0; i < builder.num_postings; ++i) {
+        free(builder.postings[i].data);
+    }
+
+    if (data != NULL) {
+        munmap((void *) data, size);
+    }
+
+    free(builder.postings);
+    free(builder.slot);
+    free(jobs);
+    free(blocks);
+
+    return ok;
+}
+
+/* - querying ---------------------------------------------------------------- */
+
+/* reads count items of size bytes from the buffer, false if it is too short */
+static bool read_items(void *dst, size_t size, size_t count, const unsigned char **pos, const unsigned char *end) {
+    if ((size_t) (end - *pos) / size < count) {
+        return false;
+    }
+
+    memcpy(dst, *pos, size * count);
+    *pos += size * count;
+    return true;
+}
+
+bool trigram_load(trigram_index_t *index, const char *filename) {
+    memset(index, 0, sizeof(trigram_index_t));
+
+    char *name = (char *) malloc(strlen(filename) + sizeof(TRIGRAM_SUFFIX));
+    if (name == NULL) {
+        return false;
+    }
+
+    sprintf(name, "%s%s", filename, TRIGRAM_SUFFIX);
+    FILE *file = fopen(name, "rb");
+    free(name);
+
+    struct stat info;
+    if (file == NULL || fstat(fileno(file), &info) != 0) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+
+    size_t size = (size_t) info.st_size;
+    unsigned char *data = (unsigned char *) malloc(size + 1);
+    bool ok = data != NULL && fread(data, 1, size, file) == size;
+    fclose(file);
+
+    const unsigned char *pos = data;
+    const unsigned char *end = data + size;
+    uint32_t reserved = 0;
+    uint64_t postings_size = 0;
+
+    ok = ok && size >= 4 && memcmp(data, MAGIC, 4) == 0;
+    pos += 4;
+
+    ok = ok && read_items(&index->num_blocks, sizeof(uint32_t), 1, &pos, end)
+        && read_items(&index->file_size, sizeof(uint64_t), 1, &pos, end)
+        && read_items(&index->num_trigrams, sizeof(uint32_t), 1, &pos, end)
+        && read_items(&reserved, sizeof(uint32_t), 1, &pos, end)
+        && read_items(&postings_size, sizeof(uint64_t), 1, &pos, end)
+        && read_items(&index->inode, sizeof(uint64_t), 1, &pos, end)
+        && read_items(index->mtime, sizeof(int64_t), 2, &pos, end);
+
+    if (ok) {
+        index->blocks = (trigram_block_t *) malloc(sizeof(trigram_block_t) * (index->num_blocks + 1));
+        index->trigrams = (uint32_t *) malloc(sizeof(uint32_t) * (index->num_trigrams + 1));
+        index->offsets = (uint64_t *) malloc(sizeof(uint64_t) * (index->num_trigrams + 1));
+        index->postings = (unsigned char *) malloc(postings_size + 1);
+
+        ok = index->blocks != NULL && index->trigrams != NULL && index->offsets != NULL && index->postings != NULL
+            && read_items(index->blocks, sizeof(trigram_block_t), index->num_blocks, &pos, end)
+            && read_items(index->trigrams, sizeof(uint32_t), index->num_trigrams, &pos, end)
+            && read_items(index->offsets, sizeof(uint64_t), index->num_trigrams + 1, &pos, end)
+            && read_items(index->postings, 1, postings_size, &pos, end)
+            && index->offsets[index->num_trigrams] == postings_size;
+    }
+
+    free(data);
+
+    if (!ok) {
+        trigram_free(index);
+    }
+
+    return ok;
+}
+
+void trigram_free(trigram_index_t *index) {
+    free(index->blocks);
+    free(index->trigrams);
+    free(index->offsets);
+    free(index->postings);
+    memset(index, 0, sizeof(trigram_index_t));
+}
+
+/* position of the trigram in the dictionary, -1 if no block has it */
+static long find_trigram(const trigram_index_t *index, uint32_t trigram) {
+    long low = 0;
+    long high = (long) index->num_trigrams - 1;
+
+    while (low <= high) {
+        long mid = (low + high) / 2;
+
+        if (index->trigrams[mid] == trigram) {
+            return mid;
+        } else if (index->trigrams[mid] < trigram) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+void trigram_filter(const trigram_index_t *index, const char *literal, size_t length, bool *candidates) {
+    bool *present = (bool *) malloc(index->num_blocks + 1);
+    if (present == NULL) {
+        return; // filtering less is always correct
+    }
+
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        const unsigned char *bytes = (const unsigned char *) literal + i;
+        uint32_t trigram = (uint32_t) fold_byte(bytes[0]) << 16 | (uint32_t) fold_byte(bytes[1]) << 8
+            | fold_byte(bytes[2]);
+        long t = find_trigram(index, trigram);
+
+        memset(present, 0, index->num_blocks);
+
+        if (t >= 0) {
+            const unsigned char *pos = index->postings + index->offsets[t];
+            const unsigned char *end = index->postings + index->offsets[t + 1];
+            uint32_t block = 0;
+
+            while (pos < end) {
+                block += decode_varint(&pos);
+
+                if (block < index->num_blocks) {
+                    present[block] = true;
+                }
+                block += 1;
+            }
+        }
+
+        for (uint32_t b = 0; b < index->num_blocks; ++b) {
+            candidates[b] = candidates[b] && present[b];
+        }
+    }
+
+    free(present);
+}
+
+/* a rewrite in place keeps the inode but not the mtime, a replaced file gets a new inode */
+static bool indexed_file(const trigram_index_t *index, const struct stat *info) {
+    return (uint64_t) info->st_size == index->file_size && (uint64_t) info->st_ino == index->inode
+        && (int64_t) info->st_mtim.tv_sec == index->mtime[0] && (int64_t) info->st_mtim.tv_nsec == index->mtime[1];
+}
+
+bool trigram_search(const search_t *search, const trigram_index_t *index, const bool *candidates,
+                    FILE *file, writer_t *out) {
+    struct stat info;
+    int fd = fileno(file);
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || !indexed_file(index, &info) || info.st_size == 0) {
+        return search_file(search, file, out); // not the indexed file any more
+    }
+
+    size_t size = (size_t) info.st_size;
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+        return search_file(search, file, out);
+    }
+
+    search_range_t *ranges = (search_range_t *) malloc(sizeof(search_range_t) * (index->num_blocks + 1));
+    if (ranges == NULL) {
+        munmap(data, size);
+        return search_file(search, file, out);
+    }
+
+    size_t num_ranges = 0;
+    for (uint32_t b = 0; b < index->num_blocks; ++b) {
+        if (candidates[b]) {
+            search_range_t range = { data + index->blocks[b].offset, index->blocks[b].length };
+            ranges[num_ranges++] = range;
+        }
+    }
+
+    // every candidate block is one chunk for the workers, output stays in block order
+    search_pool_t pool;
+    search_pool_start(&pool, search);
+    size_t count = search_pool_ranges(&pool, ranges, num_ranges, out);
+    search_pool_stop(&pool);
+
+    free(ranges);
+    munmap(data, size);
+
+    search_report(search, count, out);
+    return count > 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __TRIGRAM_H__
+#define __TRIGRAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "search.h"
+
+/* files are indexed in newline-aligned blocks of about this size */
+#define TRIGRAM_BLOCK_SIZE (1024 * 1024)
+/* the index of FILE is stored in FILE followed by this suffix */
+#define TRIGRAM_SUFFIX ".tgi"
+
+/* Indexed piece of the file, the hash tells an appended file from a rewritten one when updating */
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t hash;
+} trigram_block_t;
+
+/*
+ * Trigram index of one file. Trigrams are folded to lowercase and never
+ * contain a newline; postings are the increasing ids of the blocks holding
+ * the trigram, stored as LEB128 varints of the gaps between them.
+ */
+typedef struct {
+    uint64_t file_size;
+    uint64_t inode;
+    int64_t mtime[2];           /* seconds and nanoseconds of the indexed file */
+    uint32_t num_blocks;
+    trigram_block_t *blocks;
+
+    uint32_t num_trigrams;
+    uint32_t *trigrams;         /* sorted */
+    uint64_t *offsets;          /* num_trigrams + 1 offsets into postings */
+    unsigned char *postings;
+} trigram_index_t;
+
+/*
+ * Builds or updates the index of filename with threads threads. When the
+ * file only grew since the last build, the blocks before the last one are
+ * kept and only the rest of the file is read.
+ * returns: true on success; false and a message in *error otherwise
+ */
+bool trigram_build(const char *filename, int threads, const char **error);
+
+/*
+ * Loads the index of filename
+ * returns: true on success; false if it is missing or damaged
+ */
+bool trigram_load(trigram_index_t *index, const char *filename);
+
+/* frees the loaded index */
+void trigram_free(trigram_index_t *index);
+
+/*
+ * Clears the candidate flag of every block missing one of the trigrams
+ * of the literal; literals shorter than three bytes filter nothing
+ */
+void trigram_filter(const trigram_index_t *index, const char *literal, size_t length, bool *candidates);
+
+/*
+ * Searches only the candidate blocks of the file; a file changed since the
+ * index was built (other inode, size or mtime) is searched whole instead,
+ * so output is always the same as from search_file()
+ * returns: true if at least one line matched
+ */
+bool trigram_search(const search_t *search, const trigram_index_t *index, const bool *candidates,
+                    FILE *file, writer_t *out);
+
+#endif /* __TRIGRAM_H__ */
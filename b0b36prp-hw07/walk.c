@@ -0,0 +1,319 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "walk.h"
+
+/* One pending directory or file, the path is owned by the item */
+typedef struct {
+    char *path;
+    bool directory;
+} item_t;
+
+/* State shared by the walker threads */
+typedef struct {
+    const search_t *search;
+    writer_t *out;
+
+    item_t *items;      /* stack of pending work, depth-first keeps it small */
+    size_t num_items;
+    size_t capacity;
+    int busy;           /* threads processing an item, they may still push more */
+    bool found;         /* accessed atomically, -q stops the walk once it is set */
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_mutex_t out_lock;
+} walk_t;
+
+/* Per-thread scratch memory */
+typedef struct {
+    char *buffer;       /* small files are read here */
+    writer_t output;    /* output of the current file, so that it is written as one block */
+} worker_t;
+
+static bool push_item(walk_t *walk, char *path, bool directory) {
+    pthread_mutex_lock(&walk->lock);
+
+    if (walk->num_items == walk->capacity) {
+        size_t capacity = walk->capacity ? walk->capacity * 2 : 256;
+        item_t *items = (item_t *) realloc(walk->items, sizeof(item_t) * capacity);
+
+        if (items == NULL) {
+            pthread_mutex_unlock(&walk->lock);
+            fprintf(stderr, "Out of memory.\n");
+            free(path);
+            return false;
+        }
+
+        walk->items = items;
+        walk->capacity = capacity;
+    }
+
+    item_t item = { path, directory };
+    walk->items[walk->num_items++] = item;
+    pthread_cond_signal(&walk->work);
+    pthread_mutex_unlock(&walk->lock);
+
+    return true;
+}
+
+/* dir/name, an empty dir stands for the current directory and adds no prefix */
+static char* join_path(const char *dir, const char *name) {
+    size_t dir_length = strlen(dir);
+    size_t name_length = strlen(name);
+    bool slash = dir_length > 0 && dir[dir_length - 1] != '/';
+
+    char *path = (char *) malloc(dir_length + slash + name_length + 1);
+    if (path != NULL) {
+        memcpy(path, dir, dir_length);
+        if (slash) {
+            path[dir_length] = '/';
+        }
+        memcpy(path + dir_length + slash, name, name_length + 1);
+    }
+
+    return path;
+}
+
+static void list_directory(walk_t *walk, const char *path) {
+    DIR *dir = opendir(*path != '\0' ? path : ".");
+
+    if (dir == NULL) {
+        fprintf(stderr, "Could not open directory %s.\n", path);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        unsigned char type = entry->d_type;
+        char *child = join_path(path, name);
+
+        if (child == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            break;
+        }
+
+        // some file systems do not fill in the type
+        if (type == DT_UNKNOWN) {
+            struct stat info;
+
+            if (lstat(child, &info) == 0) {
+                type = S_ISDIR(info.st_mode) ? DT_DIR : (S_ISREG(info.st_mode) ? DT_REG : DT_LNK);
+            }
+        }
+
+        if (type == DT_DIR || type == DT_REG) {
+            push_item(walk, child, type == DT_DIR);
+
+        } else {
+            free(child);
+        }
+    }
+
+    closedir(dir);
+}
+
+/* reads the whole file into buffer, which holds WALK_SMALL_FILE bytes */
+static bool read_small(int fd, char *buffer, size_t length) {
+    size_t done = 0;
+
+    while (done < length) {
+        ssize_t count = read(fd, buffer + done, length - done);
+
+        if (count <= 0) {
+            return false;
+        }
+
+        done += (size_t) count;
+    }
+
+    return true;
+}
+
+static void search_one(walk_t *walk, worker_t *worker, const char *path) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file %s.\n", path);
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return;
+    }
+
+    // mapping and unmapping costs more than a read for small files and
+    // every munmap has to shoot down the TLB entries of the other threads
+    size_t length = (size_t) info.st_size;
+    bool mapped = length > WALK_SMALL_FILE;
+    char *buffer = worker->buffer;
+
+    if (mapped) {
+        buffer = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (buffer == MAP_FAILED) {
+            fprintf(stderr, "Could not read file %s.\n", path);
+            close(fd);
+            return;
+        }
+
+        madvise(buffer, length, MADV_SEQUENTIAL);
+
+    } else if (!read_small(fd, buffer, length)) {
+        fprintf(stderr, "Could not read file %s.\n", path);
+        close(fd);
+        return;
+    }
+
+    close(fd);
+
+    size_t sniff = length < WALK_SNIFF_SIZE ? length : WALK_SNIFF_SIZE;
+
+    if (memchr(buffer, '\0', sniff) == NULL) {
+        search_t search = *walk->search;
+        search.label = path;
+        search.threads = 1;
+
+        // the buffer is kept for the next file, only its contents and state are dropped
+        worker->output.length = 0;
+        worker->output.failed = false;
+
+        size_t count = search_buffer(&search, buffer, length, &worker->output);
+        search_report(&search, count, &worker->output);
+
+        if (count > 0) {
+            __atomic_store_n(&walk->found, true, __ATOMIC_RELAXED);
+        }
+
+        if (worker->output.length > 0 || worker->output.failed) {
+            pthread_mutex_lock(&walk->out_lock);
+            writer_write(walk->out, worker->output.data, worker->output.length);
+            walk->out->failed = walk->out->failed || worker->output.failed;
+            pthread_mutex_unlock(&walk->out_lock);
+        }
+    }
+
+    if (mapped) {
+        munmap(buffer, length);
+    }
+}
+
+static void* walk_worker(void *arg) {
+    walk_t *walk = (walk_t *) arg;
+    worker_t worker;
+    worker.buffer = (char *) malloc(WALK_SMALL_FILE);
+    writer_init(&worker.output, -1);
+
+    pthread_mutex_lock(&walk->lock);
+
+    while (worker.buffer != NULL) {
+        while (walk->num_items == 0 && walk->busy > 0) {
+            pthread_cond_wait(&walk->work, &walk->lock);
+        }
+
+        if (walk->num_items == 0) {
+            break; // nothing queued and nobody left who could queue more
+        }
+
+        if (walk->search->mode == OUTPUT_QUIET && __atomic_load_n(&walk->found, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        item_t item = walk->items[--walk->num_items];
+        ++walk->busy;
+        pthread_mutex_unlock(&walk->lock);
+
+        if (item.directory) {
+            list_directory(walk, item.path);
+
+        } else {
+            search_one(walk, &worker, item.path);
+        }
+
+        free(item.path);
+
+        pthread_mutex_lock(&walk->lock);
+        --walk->busy;
+    }
+
+    pthread_cond_broadcast(&walk->work);
+    pthread_mutex_unlock(&walk->lock);
+
+    free(worker.buffer);
+    writer_free(&worker.output);
+    return NULL;
+}
+
+bool search_tree(const search_t *search, const char *root, writer_t *out) {
+    struct stat info;
+
+    if (root != NULL && stat(root, &info) == 0 && !S_ISDIR(info.st_mode)) {
+        FILE *file = fopen(root, "r");
+
+        if (file == NULL) {
+            fprintf(stderr, "Could not open file %s.\n", root);
+            return false;
+        }
+
+        bool found = search_file(search, file, out);
+        fclose(file);
+        return found;
+    }
+
+    walk_t walk = { search, out, NULL, 0, 0, 0, false };
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.work, NULL);
+    pthread_mutex_init(&walk.out_lock, NULL);
+
+    // the root is the first directory to walk, without it there is nothing to do
+    char *path = strdup(root != NULL ? root : "");
+    if (path == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+    }
+
+    bool walking = path != NULL && push_item(&walk, path, true);
+    int threads = search->threads > 1 ? search->threads : 1;
+    pthread_t *workers = walking ? (pthread_t *) malloc(sizeof(pthread_t) * threads) : NULL;
+
+    int started = 0;
+    while (workers != NULL && started < threads && pthread_create(&workers[started], NULL, walk_worker, &walk) == 0) {
+        ++started;
+    }
+
+    if (walking && started == 0) {
+        walk_worker(&walk); // no threads available, do the work here
+    }
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (size_t i = 0; i < walk.num_items; ++i) {
+        free(walk.items[i].path);
+    }
+
+    pthread_mutex_destroy(&walk.out_lock);
+    pthread_cond_destroy(&walk.work);
+    pthread_mutex_destroy(&walk.lock);
+    free(walk.items);
+    free(workers);
+
+    return walk.found;
+}
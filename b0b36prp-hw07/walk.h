@@ -0,0 +1,24 @@
+#ifndef __WALK_H__
+#define __WALK_H__
+
+#include <stdbool.h>
+
+#include "search.h"
+
+/* files whose first bytes contain a NUL byte are treated as binary and skipped */
+#define WALK_SNIFF_SIZE (32 * 1024)
+/* files up to this size are read into a per-thread buffer instead of being mapped */
+#define WALK_SMALL_FILE (64 * 1024)
+
+/*
+ * Searches every regular file below root (the current directory if NULL)
+ * with search->threads threads sharing one work queue of directories and
+ * files. Symbolic links inside the tree are not followed, binary files are
+ * skipped. Lines are prefixed by the file name and the output of every file
+ * is written as one block. A root that is not a directory is searched alone
+ * without the prefix.
+ * returns: true if at least one line matched
+ */
+bool search_tree(const search_t *search, const char *root, writer_t *out);
+
+#endif /* __WALK_H__ */
@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "writer.h"
+
+/* writes all vectors, retrying after partial writes and interrupts */
+static bool write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        while (count > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+/* makes room for length more bytes in a memory writer */
+static bool grow(writer_t *writer, size_t length) {
+    size_t capacity = writer->capacity ? writer->capacity : 4096;
+
+    while (capacity - writer->length < length) {
+        capacity *= 2;
+    }
+
+    char *data = (char *) realloc(writer->data, capacity);
+    if (data == NULL) {
+        return false;
+    }
+
+    writer->data = data;
+    writer->capacity = capacity;
+    return true;
+}
+
+void writer_init(writer_t *writer, int fd) {
+    writer->fd = fd;
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+    writer->failed = false;
+
+    if (fd >= 0) {
+        writer->data = (char *) malloc(WRITER_BLOCK);
+        writer->capacity = writer->data != NULL ? WRITER_BLOCK : 0;
+    }
+}
+
+void writer_write(writer_t *writer, const char *data, size_t length) {
+    if (writer->capacity - writer->length >= length) {
+        memcpy(writer->data + writer->length, data, length);
+        writer->length += length;
+        return;
+    }
+
+    if (writer->fd < 0) {
+        if (grow(writer, length)) {
+            memcpy(writer->data + writer->length, data, length);
+            writer->length += length;
+
+        } else {
+            writer->failed = true;
+        }
+        return;
+    }
+
+    // a span that does not fit is written right after the buffer, a short one
+    // is copied into the emptied buffer
+    if (length < writer->capacity) {
+        writer_flush(writer);
+        memcpy(writer->data, data, length);
+        writer->length = length;
+        return;
+    }
+
+    struct iovec iov[2] = {
+        { writer->data, writer->length },
+        { (void *) data, length }
+    };
+
+    if (!write_all(writer->fd, iov, 2)) {
+        writer->failed = true;
+    }
+
+    writer->length = 0;
+}
+
+void writer_puts(writer_t *writer, const char *string) {
+    writer_write(writer, string, strlen(string));
+}
+
+void writer_putc(writer_t *writer, char c) {
+    writer_write(writer, &c, 1);
+}
+
+bool writer_flush(writer_t *writer) {
+    if (writer->fd >= 0 && writer->length > 0) {
+        struct iovec iov = { writer->data, writer->length };
+
+        if (!write_all(writer->fd, &iov, 1)) {
+            writer->failed = true;
+        }
+
+        writer->length = 0;
+    }
+
+    return !writer->failed;
+}
+
+void writer_free(writer_t *writer) {
+    free(writer->data);
+    writer->data = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+}
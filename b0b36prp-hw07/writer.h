@@ -0,0 +1,44 @@
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* output is handed to the kernel in blocks of this size */
+#define WRITER_BLOCK (256 * 1024)
+
+/*
+ * Output buffer. With a file descriptor the buffer is flushed in large
+ * blocks and big spans are written together with it by one writev(),
+ * without a descriptor it only grows and collects the output in memory.
+ */
+typedef struct {
+    int fd;
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} writer_t;
+
+/* Initializes the writer, fd < 0 keeps the output in memory */
+void writer_init(writer_t *writer, int fd);
+
+/* appends length bytes */
+void writer_write(writer_t *writer, const char *data, size_t length);
+
+/* appends a zero-terminated string */
+void writer_puts(writer_t *writer, const char *string);
+
+/* appends one byte */
+void writer_putc(writer_t *writer, char c);
+
+/*
+ * Writes the buffered output to the descriptor
+ * returns: false if any write so far has failed
+ */
+bool writer_flush(writer_t *writer);
+
+/* frees the buffer without flushing it */
+void writer_free(writer_t *writer);
+
+#endif /* __WRITER_H__ */
@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <time.h>
+
+#include "blocking_queue.h"
+
+#define MS_IN_S 1000
+#define NS_IN_MS 1000000
+#define NS_IN_S 1000000000L
+
+/* converts a relative timeout to the absolute time pthread_cond_timedwait() expects */
+static void deadline_from_timeout(struct timespec *deadline, int timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / MS_IN_S;
+    deadline->tv_nsec += (long) (timeout_ms % MS_IN_S) * NS_IN_MS;
+
+    if (deadline->tv_nsec >= NS_IN_S) {
+        deadline->tv_sec += 1;
+        deadline->tv_nsec -= NS_IN_S;
+    }
+}
+
+/* waits on cond, returns false once the deadline (if any) has passed */
+static bool wait_on(pthread_cond_t *cond, pthread_mutex_t *lock, const struct timespec *deadline) {
+    if (deadline == NULL) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+/* wakes up to count waiters with as few calls as possible */
+static void wake(pthread_cond_t *cond, int waiting, int count) {
+    if (waiting == 0 || count == 0) {
+        return;
+    }
+
+    if (count >= waiting) {
+        pthread_cond_broadcast(cond);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        pthread_cond_signal(cond);
+    }
+}
+
+static bool is_full(blocking_queue_t *queue) {
+    return queue->limit > 0 && get_queue_size(queue->queue) >= queue->limit;
+}
+
+blocking_queue_t* create_blocking_queue(int capacity, int limit) {
+    blocking_queue_t *queue = (blocking_queue_t *) malloc(sizeof(blocking_queue_t));
+    if (!queue) {
+        return NULL;
+    }
+
+    queue->queue = create_queue(capacity);
+    if (!queue->queue) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->limit = limit;
+    queue->closed = false;
+    queue->waiting_consumers = 0;
+    queue->waiting_producers = 0;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+
+    return queue;
+}
+
+void delete_blocking_queue(blocking_queue_t *queue) {
+    if (queue != NULL) {
+        pthread_cond_destroy(&queue->not_full);
+        pthread_cond_destroy(&queue->not_empty);
+        pthread_mutex_destroy(&queue->lock);
+        delete_queue(queue->queue);
+        free(queue);
+    }
+}
+
+bool push_to_blocking_queue(blocking_queue_t *queue, void *data) {
+    return push_timeout(queue, data, -1);
+}
+
+bool push_timeout(blocking_queue_t *queue, void *data, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        deadline_from_timeout(&deadline, timeout_ms);
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    bool ret = true;
+    while (!queue->closed && is_full(queue)) {
+        queue->waiting_producers += 1;
+        ret = wait_on(&queue->not_full, &queue->lock, timeout_ms >= 0 ? &deadline : NULL);
+        queue->waiting_producers -= 1;
+
+        if (!ret) {
+            break;
+        }
+    }
+
+    // the condition is rechecked, a timed out wait may still have gotten space
+    ret = !queue->closed && !is_full(queue) && push_to_queue(queue->queue, data);
+    if (ret) {
+        wake(&queue->not_empty, queue->waiting_consumers, 1);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+int push_batch_to_blocking_queue(blocking_queue_t *queue, void **data, int count) {
+    int pushed = 0;
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (pushed < count && !queue->closed) {
+        int batch = 0;
+        while (pushed + batch < count && !is_full(queue)) {
+            if (!push_to_queue(queue->queue, data[pushed + batch])) {
+                break;
+            }
+            ++batch;
+        }
+
+        pushed += batch;
+        wake(&queue->not_empty, queue->waiting_consumers, batch);
+
+        if (pushed < count && is_full(queue)) {
+            queue->waiting_producers += 1;
+            wait_on(&queue->not_full, &queue->lock, NULL);
+            queue->waiting_producers -= 1;
+
+        } else if (batch == 0) {
+            break; // the underlying queue refused the element
+        }
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return pushed;
+}
+
+void* pop_from_blocking_queue(blocking_queue_t *queue) {
+    return pop_timeout(queue, -1);
+}
+
+void* pop_timeout(blocking_queue_t *queue, int timeout_ms) {
+    void *data = NULL;
+    return pop_batch_from_blocking_queue(queue, &data, 1, timeout_ms) == 1 ? data : NULL;
+}
+
+int pop_batch_from_blocking_queue(blocking_queue_t *queue, void **data, int max_count, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        deadline_from_timeout(&deadline, timeout_ms);
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (!queue->closed && get_queue_size(queue->queue) == 0) {
+        queue->waiting_consumers += 1;
+        bool ret = wait_on(&queue->not_empty, &queue->lock, timeout_ms >= 0 ? &deadline : NULL);
+        queue->waiting_consumers -= 1;
+
+        if (!ret) {
+            break;
+        }
+    }
+
+    int popped = 0;
+    while (popped < max_count && get_queue_size(queue->queue) > 0) {
+        data[popped++] = pop_from_queue(queue->queue);
+    }
+
+    wake(&queue->not_full, queue->waiting_producers, popped);
+
+    pthread_mutex_unlock(&queue->lock);
+    return popped;
+}
+
+void close_blocking_queue(blocking_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+int get_blocking_queue_size(blocking_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    int size = get_queue_size(queue->queue);
+    pthread_mutex_unlock(&queue->lock);
+    return size;
+}
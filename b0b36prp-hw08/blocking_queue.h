@@ -0,0 +1,84 @@
+#ifndef __BLOCKING_QUEUE_H__
+#define __BLOCKING_QUEUE_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "queue.h"
+
+/*
+ * Thread-safe wrapper around queue_t. Consumers sleep on a condition
+ * variable while the queue is empty, producers sleep while the queue
+ * holds `limit` elements (limit <= 0 means unbounded).
+ */
+typedef struct {
+    queue_t *queue;
+    int limit;
+    bool closed;
+    int waiting_consumers;
+    int waiting_producers;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} blocking_queue_t;
+
+/* creates a new blocking queue with a given initial capacity and size limit */
+blocking_queue_t* create_blocking_queue(int capacity, int limit);
+
+/*
+ * deletes the queue and all allocated memory, the queue must not be used
+ * by any thread anymore
+ */
+void delete_blocking_queue(blocking_queue_t *queue);
+
+/*
+ * inserts a reference to the element, waits while the queue is full
+ * returns: true on success; false if the queue has been closed
+ */
+bool push_to_blocking_queue(blocking_queue_t *queue, void *data);
+
+/*
+ * same as push_to_blocking_queue(), but waits at most timeout_ms
+ * milliseconds (negative timeout waits forever)
+ * returns: true on success; false on timeout or if the queue has been closed
+ */
+bool push_timeout(blocking_queue_t *queue, void *data, int timeout_ms);
+
+/*
+ * inserts count elements, waiting for free space as needed; waiting
+ * consumers are woken once per batch instead of once per element
+ * returns: number of inserted elements (less than count only if the queue
+ * has been closed meanwhile)
+ */
+int push_batch_to_blocking_queue(blocking_queue_t *queue, void **data, int count);
+
+/*
+ * removes the first element, waits while the queue is empty
+ * returns: the first element; NULL once the queue is closed and drained
+ */
+void* pop_from_blocking_queue(blocking_queue_t *queue);
+
+/*
+ * same as pop_from_blocking_queue(), but waits at most timeout_ms
+ * milliseconds (negative timeout waits forever)
+ * returns: the first element; NULL on timeout or once closed and drained
+ */
+void* pop_timeout(blocking_queue_t *queue, int timeout_ms);
+
+/*
+ * removes up to max_count elements into data, waits at most timeout_ms
+ * milliseconds for the first one; waiting producers are woken once per batch
+ * returns: number of removed elements
+ */
+int pop_batch_from_blocking_queue(blocking_queue_t *queue, void **data, int max_count, int timeout_ms);
+
+/*
+ * closes the queue and wakes up all waiting threads; further pushes fail,
+ * pops still drain the remaining elements
+ */
+void close_blocking_queue(blocking_queue_t *queue);
+
+/* gets number of stored elements */
+int get_blocking_queue_size(blocking_queue_t *queue);
+
+#endif /* __BLOCKING_QUEUE_H__ */
@@ -0,0 +1,223 @@
+#include "deque.h"
+
+#define INIT_MAP_CAPACITY 8
+
+/* index of the map slot holding the i-th block counted from the first one */
+static inline int map_slot(const deque_t *deque, int i) {
+    return (deque->first_block + i) & (deque->map_capacity - 1);
+}
+
+static inline void*** block_at(const deque_t *deque, int i) {
+    return &deque->map[map_slot(deque, i)];
+}
+
+/* stores the i-th block into the map and, while it grows, into the next map too */
+static void set_block(deque_t *deque, int i, void **block) {
+    *block_at(deque, i) = block;
+
+    if (deque->next_map != NULL) {
+        deque->next_map[(deque->first_block + i) & (2 * deque->map_capacity - 1)] = block;
+    }
+}
+
+static void** acquire_block(deque_t *deque) {
+    if (deque->num_free > 0) {
+        return deque->free_blocks[--deque->num_free];
+    }
+
+    return (void **) malloc(sizeof(void *) * DEQUE_BLOCK_SIZE);
+}
+
+static void release_block(deque_t *deque, void **block) {
+    if (deque->num_free < DEQUE_FREE_BLOCKS) {
+        deque->free_blocks[deque->num_free++] = block;
+    } else {
+        free(block);
+    }
+}
+
+/*
+ * moves up to count block pointers into the next map, switching to it once
+ * all blocks are there; blocks added meanwhile are already in both maps
+ */
+static void migrate(deque_t *deque, int count) {
+    int next_mask = 2 * deque->map_capacity - 1;
+
+    // blocks popped from the front need not be moved anymore
+    if ((int) (deque->migrated - deque->first_block) < 0) {
+        deque->migrated = deque->first_block;
+    }
+
+    while (count-- > 0 && (int) (deque->migrated - deque->first_block) < deque->num_blocks) {
+        deque->next_map[deque->migrated & next_mask] = deque->map[deque->migrated & (deque->map_capacity - 1)];
+        deque->migrated += 1;
+    }
+
+    if ((int) (deque->migrated - deque->first_block) >= deque->num_blocks) {
+        free(deque->map);
+        deque->map = deque->next_map;
+        deque->map_capacity *= 2;
+        deque->next_map = NULL;
+    }
+}
+
+/* makes room in the map for one more block, returns false if the map cannot grow */
+static bool reserve_block(deque_t *deque) {
+    if (deque->next_map == NULL && deque->num_blocks >= deque->map_capacity / 2) {
+        deque->next_map = (void ***) malloc(sizeof(void **) * 2 * deque->map_capacity);
+        deque->migrated = deque->first_block;
+    }
+
+    if (deque->next_map != NULL) {
+        // the whole map is moved at once only if the step could not keep up
+        migrate(deque, deque->num_blocks < deque->map_capacity ? DEQUE_MIGRATE_STEP : deque->num_blocks);
+    }
+
+    return deque->num_blocks < deque->map_capacity;
+}
+
+deque_t* create_deque(int capacity) {
+    deque_t *deque = (deque_t *) malloc(sizeof(deque_t));
+    if (!deque) {
+        return NULL;
+    }
+
+    int map_capacity = INIT_MAP_CAPACITY;
+    while (map_capacity * DEQUE_BLOCK_SIZE < capacity) {
+        map_capacity *= 2;
+    }
+
+    deque->map = (void ***) malloc(sizeof(void **) * map_capacity);
+    if (!deque->map) {
+        free(deque);
+        return NULL;
+    }
+
+    deque->map_capacity = map_capacity;
+    deque->next_map = NULL;
+    deque->migrated = 0;
+    deque->first_block = 0;
+    deque->num_blocks = 0;
+    deque->head = 0;
+    deque->size = 0;
+    deque->num_free = 0;
+
+    return deque;
+}
+
+void delete_deque(deque_t *deque) {
+    if (deque != NULL) {
+        for (int i = 0; i < deque->num_blocks; ++i) {
+            free(*block_at(deque, i));
+        }
+
+        for (int i = 0; i < deque->num_free; ++i) {
+            free(deque->free_blocks[i]);
+        }
+
+        free(deque->next_map);
+        free(deque->map);
+        free(deque);
+    }
+}
+
+bool push_back_to_deque(deque_t *deque, void *data) {
+    int pos = deque->head + deque->size;
+
+    if (pos == deque->num_blocks * DEQUE_BLOCK_SIZE) {
+        if (!reserve_block(deque)) {
+            return false;
+        }
+
+        void **block = acquire_block(deque);
+        if (!block) {
+            return false;
+        }
+
+        set_block(deque, deque->num_blocks, block);
+        deque->num_blocks += 1;
+    }
+
+    (*block_at(deque, pos / DEQUE_BLOCK_SIZE))[pos % DEQUE_BLOCK_SIZE] = data;
+    deque->size += 1;
+
+    return true;
+}
+
+bool push_front_to_deque(deque_t *deque, void *data) {
+    if (deque->head == 0) {
+        if (!reserve_block(deque)) {
+            return false;
+        }
+
+        void **block = acquire_block(deque);
+        if (!block) {
+            return false;
+        }
+
+        deque->first_block -= 1;
+        deque->num_blocks += 1;
+        set_block(deque, 0, block);
+        deque->head = DEQUE_BLOCK_SIZE;
+    }
+
+    deque->head -= 1;
+    (*block_at(deque, 0))[deque->head] = data;
+    deque->size += 1;
+
+    return true;
+}
+
+void* pop_front_from_deque(deque_t *deque) {
+    if (deque->size == 0) {
+        return NULL;
+    }
+
+    void *data = (*block_at(deque, 0))[deque->head];
+    deque->head += 1;
+    deque->size -= 1;
+
+    if (deque->head == DEQUE_BLOCK_SIZE || deque->size == 0) {
+        release_block(deque, *block_at(deque, 0));
+        deque->first_block += 1;
+        deque->num_blocks -= 1;
+        deque->head = 0;
+    }
+
+    return data;
+}
+
+void* pop_back_from_deque(deque_t *deque) {
+    if (deque->size == 0) {
+        return NULL;
+    }
+
+    deque->size -= 1;
+    int pos = deque->head + deque->size;
+    void *data = (*block_at(deque, pos / DEQUE_BLOCK_SIZE))[pos % DEQUE_BLOCK_SIZE];
+
+    // drop the last block once nothing lives in it anymore
+    if (pos == (deque->num_blocks - 1) * DEQUE_BLOCK_SIZE || deque->size == 0) {
+        release_block(deque, *block_at(deque, deque->num_blocks - 1));
+        deque->num_blocks -= 1;
+    }
+
+    if (deque->size == 0) {
+        deque->head = 0;
+    }
+
+    return data;
+}
+
+void* get_from_deque(deque_t *deque, int idx) {
+    if (idx < 0 || idx >= deque->size) {
+        return NULL;
+    }
+
+    int pos = deque->head + idx;
+    return (*block_at(deque, pos / DEQUE_BLOCK_SIZE))[pos % DEQUE_BLOCK_SIZE];
+}
+
+int get_deque_size(deque_t *deque) {
+    return deque->size;
+}
@@ -0,0 +1,74 @@
+#ifndef __DEQUE_H__
+#define __DEQUE_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* number of element slots in one block, must be a power of two */
+#define DEQUE_BLOCK_SIZE 64
+/* number of empty blocks kept around for reuse */
+#define DEQUE_FREE_BLOCKS 4
+/* block pointers moved to the next map per added block while the map grows */
+#define DEQUE_MIGRATE_STEP 4
+
+/*
+ * Segmented deque made of fixed-size blocks. The block index (map) is a
+ * ring of block pointers, so growing never moves the stored elements.
+ * Once the map is half full, a map of twice the size is allocated and the
+ * block pointers are moved into it a few at a time with every added block,
+ * so no push or pop ever copies the whole map.
+ */
+typedef struct {
+    void ***map;
+    int map_capacity;
+    void ***next_map;           /* the doubled map being filled, or NULL */
+    unsigned int migrated;      /* the next block to move into next_map */
+    unsigned int first_block;   /* blocks are numbered on, the map slot is the number masked */
+    int num_blocks;
+    int head;
+    int size;
+    void **free_blocks[DEQUE_FREE_BLOCKS];
+    int num_free;
+} deque_t;
+
+/* creates a new deque with room for at least capacity elements in the map */
+deque_t* create_deque(int capacity);
+
+/* deletes the deque and all allocated memory */
+void delete_deque(deque_t *deque);
+
+/*
+ * inserts a reference to the element at the end of the deque
+ * returns: true on success; false otherwise
+ */
+bool push_back_to_deque(deque_t *deque, void *data);
+
+/*
+ * inserts a reference to the element at the front of the deque
+ * returns: true on success; false otherwise
+ */
+bool push_front_to_deque(deque_t *deque, void *data);
+
+/*
+ * gets the first element from the deque and removes it
+ * returns: the first element on success; NULL otherwise
+ */
+void* pop_front_from_deque(deque_t *deque);
+
+/*
+ * gets the last element from the deque and removes it
+ * returns: the last element on success; NULL otherwise
+ */
+void* pop_back_from_deque(deque_t *deque);
+
+/*
+ * gets idx-th element from the front of the deque
+ * returns: the idx-th element on success; NULL otherwise
+ */
+void* get_from_deque(deque_t *deque, int idx);
+
+/* gets number of stored elements */
+int get_deque_size(deque_t *deque);
+
+#endif /* __DEQUE_H__ */
@@ -0,0 +1,82 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scheduler.h"
+
+/* below this n the recursion runs serially to amortize the task overhead */
+#define SERIAL_CUTOFF 20
+#define DEFAULT_N 36
+
+typedef struct {
+    int n;
+    long result;
+} fib_arg_t;
+
+static long fib_serial(int n) {
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+/* fork/join fibonacci: spawn one half, compute the other, then join */
+static void fib_task(worker_t *worker, void *arg) {
+    fib_arg_t *fib = (fib_arg_t *) arg;
+
+    if (fib->n < SERIAL_CUTOFF) {
+        fib->result = fib_serial(fib->n);
+        return;
+    }
+
+    fib_arg_t left = { fib->n - 1, 0 };
+    fib_arg_t right = { fib->n - 2, 0 };
+    task_t task;
+
+    spawn_task(worker, &task, fib_task, &left);
+    fib_task(worker, &right);
+    sync_task(worker, &task);
+
+    fib->result = left.result + right.result;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * BENCHMARK
+ * - usage: fib_bench [n] [max_threads]
+ * - prints the serial time and the scheduler time for 1..max_threads workers
+ */
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_N;
+    int max_threads = argc > 2 ? atoi(argv[2]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    double start = now();
+    long expected = fib_serial(n);
+    double serial = now() - start;
+    printf("serial      fib(%d) = %ld  %.3f s\n", n, expected, serial);
+
+    for (int threads = 1; threads <= max_threads; ++threads) {
+        scheduler_t *scheduler = create_scheduler(threads);
+        if (!scheduler) {
+            fprintf(stderr, "Could not create scheduler.\n");
+            return EXIT_FAILURE;
+        }
+
+        fib_arg_t root = { n, 0 };
+        start = now();
+        scheduler_run(scheduler, fib_task, &root);
+        double elapsed = now() - start;
+
+        printf("%2d threads  fib(%d) = %ld  %.3f s  speedup %.2fx%s\n", threads, n, root.result,
+               elapsed, serial / elapsed, root.result == expected ? "" : "  WRONG RESULT");
+
+        delete_scheduler(scheduler);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,26 @@
+#ifdef QUEUE_STATS
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <time.h>
+#endif
+
 #include "queue.h"
 
+#ifdef QUEUE_STATS
+#define NS_IN_S 1000000000ULL
+#define STAT(stmt) do { stmt; } while (0)
+#define STAT_DECL(decl) decl
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * NS_IN_S + ts.tv_nsec;
+}
+#else
+#define STAT(stmt) do { } while (0)
+#define STAT_DECL(decl)
+#endif
+
 queue_t* create_queue(int capacity) {
     if (capacity == 0) {
         return NULL;
@@ -20,6 +41,7 @@ queue_t* create_queue(int capacity) {
     queue->tail = 0;
     queue->size = 0;
     queue->capacity = capacity;
+    STAT(memset(&queue->stats, 0, sizeof(queue->stats)));
 
     return queue;
 }
@@ -36,6 +58,7 @@ void delete_queue(queue_t *queue) {
 
 bool push_to_queue(queue_t *queue, void *data) {
     if (queue->size == queue->capacity) {
+        STAT_DECL(unsigned long long start = now_ns();)
         int old_capacity = queue->capacity;
 
         void **old_queue = queue->queue;
@@ -52,12 +75,21 @@ bool push_to_queue(queue_t *queue, void *data) {
         queue->head = 0;
         queue->tail = old_capacity;
         queue->capacity *= 2;
+
+        STAT(queue->stats.grows += 1;
+             queue->stats.bytes_copied += sizeof(void *) * old_capacity;
+             queue->stats.resize_ns += now_ns() - start);
     }
 
     queue->queue[queue->tail] = data;
     queue->tail = (queue->tail + 1) % queue->capacity;
     queue->size += 1;
 
+    STAT(queue->stats.pushes += 1;
+         if (queue->size > queue->stats.peak_size) {
+             queue->stats.peak_size = queue->size;
+         });
+
     return true;
 }
 
@@ -70,8 +102,10 @@ void* pop_from_queue(queue_t *queue) {
     queue->queue[queue->head] = NULL;
     queue->head = (queue->head + 1) % queue->capacity;
     queue->size -= 1;
+    STAT(queue->stats.pops += 1);
 
     if (queue->size != 0 && queue->size < queue->capacity / 2) {
+        STAT_DECL(unsigned long long start = now_ns();)
         int old_capacity = queue->capacity;
         int amount_to_remove = queue->capacity / 3;
         int new_capacity = old_capacity - amount_to_remove;
@@ -91,6 +125,10 @@ void* pop_from_queue(queue_t *queue) {
         queue->head = 0;
         queue->tail = queue->size;
         queue->capacity = new_capacity;
+
+        STAT(queue->stats.shrinks += 1;
+             queue->stats.bytes_copied += sizeof(void *) * curr_size;
+             queue->stats.resize_ns += now_ns() - start);
     }
 
     return data;
@@ -107,3 +145,29 @@ void* get_from_queue(queue_t *queue, int idx) {
 int get_queue_size(queue_t *queue) {
     return queue->size;
 }
+
+bool queue_get_stats(queue_t *queue, queue_stats_t *stats) {
+#ifdef QUEUE_STATS
+    *stats = queue->stats;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void queue_dump_stats(queue_t *queue, FILE *out) {
+    queue_stats_t stats;
+
+    if (!queue_get_stats(queue, &stats)) {
+        fprintf(out, "queue statistics disabled (build with -DQUEUE_STATS)\n");
+        return;
+    }
+
+    fprintf(out, "pushes:        %lu\n", stats.pushes);
+    fprintf(out, "pops:          %lu\n", stats.pops);
+    fprintf(out, "grows:         %lu\n", stats.grows);
+    fprintf(out, "shrinks:       %lu\n", stats.shrinks);
+    fprintf(out, "bytes copied:  %lu\n", stats.bytes_copied);
+    fprintf(out, "peak size:     %d\n", stats.peak_size);
+    fprintf(out, "resize time:   %.3f ms\n", stats.resize_ns / 1e6);
+}
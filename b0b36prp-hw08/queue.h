@@ -5,6 +5,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/*
+ * Queue counters, collected only when compiled with -DQUEUE_STATS
+ * (make STATS=1); otherwise queue_t does not carry them at all
+ */
+typedef struct {
+    unsigned long pushes;
+    unsigned long pops;
+    unsigned long grows;
+    unsigned long shrinks;
+    unsigned long bytes_copied;
+    int peak_size;
+    unsigned long long resize_ns;
+} queue_stats_t;
+
 /* Queue structure which holds all necessary data */
 typedef struct {
     void **queue;
@@ -12,6 +26,9 @@ typedef struct {
     int tail;
     int size;
     int capacity;
+#ifdef QUEUE_STATS
+    queue_stats_t stats;
+#endif
 } queue_t;
 
 /* creates a new queue with a given size */
@@ -42,4 +59,13 @@ void* get_from_queue(queue_t *queue, int idx);
 /* gets number of stored elements */
 int get_queue_size(queue_t *queue);
 
+/*
+ * copies the collected counters into stats
+ * returns: true on success; false if statistics are compiled out
+ */
+bool queue_get_stats(queue_t *queue, queue_stats_t *stats);
+
+/* prints the collected counters in a human readable form */
+void queue_dump_stats(queue_t *queue, FILE *out);
+
 #endif /* __QUEUE_H__ */
@@ -0,0 +1,200 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <sched.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+
+/* failed steal rounds after which an idle worker yields the CPU */
+#define SPIN_ROUNDS 64
+
+static unsigned int next_random(worker_t *worker) {
+    // xorshift32, good enough to pick victims
+    unsigned int x = worker->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    worker->seed = x;
+    return x;
+}
+
+static void execute(worker_t *worker, task_t *task) {
+    task->func(worker, task->arg);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/* pops own work first, then tries one randomly chosen victim */
+static task_t* find_task(worker_t *worker) {
+    task_t *task = (task_t *) ws_pop(worker->deque);
+    if (task != NULL) {
+        return task;
+    }
+
+    int num_workers = worker->scheduler->num_workers;
+    if (num_workers < 2) {
+        return NULL;
+    }
+
+    int victim = next_random(worker) % (num_workers - 1);
+    if (victim >= worker->id) {
+        ++victim; // never steal from ourselves
+    }
+
+    return (task_t *) ws_steal(worker->scheduler->workers[victim].deque);
+}
+
+static void* worker_loop(void *arg) {
+    worker_t *worker = (worker_t *) arg;
+    scheduler_t *scheduler = worker->scheduler;
+
+    while (true) {
+        pthread_mutex_lock(&scheduler->lock);
+        while (!scheduler->active && !scheduler->shutdown) {
+            pthread_cond_wait(&scheduler->wakeup, &scheduler->lock);
+        }
+        bool shutdown = scheduler->shutdown;
+        pthread_mutex_unlock(&scheduler->lock);
+
+        if (shutdown) {
+            break;
+        }
+
+        int failed = 0;
+        while (__atomic_load_n(&scheduler->active, __ATOMIC_ACQUIRE)) {
+            task_t *task = find_task(worker);
+
+            if (task != NULL) {
+                execute(worker, task);
+                failed = 0;
+
+            } else if (++failed == SPIN_ROUNDS) {
+                sched_yield();
+                failed = 0;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+scheduler_t* create_scheduler(int num_workers) {
+    if (num_workers < 1) {
+        return NULL;
+    }
+
+    scheduler_t *scheduler = (scheduler_t *) malloc(sizeof(scheduler_t));
+    if (!scheduler) {
+        return NULL;
+    }
+
+    scheduler->workers = (worker_t *) malloc(sizeof(worker_t) * num_workers);
+    if (!scheduler->workers) {
+        free(scheduler);
+        return NULL;
+    }
+
+    scheduler->num_workers = num_workers;
+    scheduler->active = false;
+    scheduler->shutdown = false;
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->wakeup, NULL);
+
+    for (int i = 0; i < num_workers; ++i) {
+        worker_t *worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->deque = create_ws_deque(0);
+        worker->id = i;
+        worker->seed = 2463534242u + i * 2654435761u;
+
+        if (!worker->deque) {
+            // no thread runs yet, so there is nothing to join
+            while (i-- > 0) {
+                delete_ws_deque(scheduler->workers[i].deque);
+            }
+
+            pthread_cond_destroy(&scheduler->wakeup);
+            pthread_mutex_destroy(&scheduler->lock);
+            free(scheduler->workers);
+            free(scheduler);
+            return NULL;
+        }
+    }
+
+    int started = 1;
+    while (started < num_workers && pthread_create(&scheduler->workers[started].thread, NULL, worker_loop,
+                                                   &scheduler->workers[started]) == 0) {
+        ++started;
+    }
+
+    // workers without a thread would never have their deques drained, so they are dropped;
+    // the running threads read num_workers only after scheduler_run() has taken the lock
+    for (int i = started; i < num_workers; ++i) {
+        delete_ws_deque(scheduler->workers[i].deque);
+    }
+    scheduler->num_workers = started;
+
+    return scheduler;
+}
+
+void delete_scheduler(scheduler_t *scheduler) {
+    if (scheduler == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->shutdown = true;
+    pthread_cond_broadcast(&scheduler->wakeup);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (int i = 0; i < scheduler->num_workers; ++i) {
+        if (i > 0) {
+            pthread_join(scheduler->workers[i].thread, NULL);
+        }
+        delete_ws_deque(scheduler->workers[i].deque);
+    }
+
+    pthread_cond_destroy(&scheduler->wakeup);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler->workers);
+    free(scheduler);
+}
+
+void scheduler_run(scheduler_t *scheduler, task_func_t func, void *arg) {
+    pthread_mutex_lock(&scheduler->lock);
+    __atomic_store_n(&scheduler->active, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&scheduler->wakeup);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    func(&scheduler->workers[0], arg);
+
+    pthread_mutex_lock(&scheduler->lock);
+    __atomic_store_n(&scheduler->active, false, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+void spawn_task(worker_t *worker, task_t *task, task_func_t func, void *arg) {
+    task->func = func;
+    task->arg = arg;
+    task->done = 0;
+
+    if (!ws_push(worker->deque, task)) {
+        execute(worker, task); // out of memory, run it inline instead
+    }
+}
+
+void sync_task(worker_t *worker, task_t *task) {
+    int failed = 0;
+
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        task_t *other = find_task(worker);
+
+        if (other != NULL) {
+            execute(worker, other);
+            failed = 0;
+
+        } else if (++failed == SPIN_ROUNDS) {
+            sched_yield();
+            failed = 0;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "ws_deque.h"
+
+typedef struct scheduler scheduler_t;
+typedef struct worker worker_t;
+
+/* task body, runs on the given worker and may spawn further tasks there */
+typedef void (*task_func_t)(worker_t *worker, void *arg);
+
+/* fork/join task, usually lives on the stack of the spawning function */
+typedef struct {
+    task_func_t func;
+    void *arg;
+    int done;
+} task_t;
+
+/* per-thread state, each worker owns one work-stealing deque */
+struct worker {
+    scheduler_t *scheduler;
+    ws_deque_t *deque;
+    int id;
+    unsigned int seed;
+    pthread_t thread;
+};
+
+struct scheduler {
+    worker_t *workers;
+    int num_workers;
+    bool active;
+    bool shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+};
+
+/*
+ * creates a scheduler with num_workers workers; the thread calling
+ * scheduler_run() acts as worker 0, so num_workers - 1 threads are started;
+ * if some of them cannot be started, the scheduler keeps fewer workers
+ */
+scheduler_t* create_scheduler(int num_workers);
+
+/* stops all worker threads and frees all allocated memory */
+void delete_scheduler(scheduler_t *scheduler);
+
+/* runs func(arg) as the root task and returns once it has finished */
+void scheduler_run(scheduler_t *scheduler, task_func_t func, void *arg);
+
+/* makes the task available to other workers, it must be joined by sync_task() */
+void spawn_task(worker_t *worker, task_t *task, task_func_t func, void *arg);
+
+/* waits for a spawned task, executing other tasks in the meantime */
+void sync_task(worker_t *worker, task_t *task);
+
+#endif /* __SCHEDULER_H__ */
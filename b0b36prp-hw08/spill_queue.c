@@ -0,0 +1,226 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "spill_queue.h"
+
+/* the spill file grows at least by this many bytes at once */
+#define SPILL_CHUNK (64UL * 1024 * 1024)
+/* records are aligned so that the length headers stay naturally aligned */
+#define RECORD_ALIGN 8
+
+/* on-disk record: a length header followed by the padded payload */
+typedef struct {
+    uint64_t size;
+} record_header_t;
+
+static size_t record_size(size_t payload) {
+    size_t size = sizeof(record_header_t) + payload;
+    return (size + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1);
+}
+
+/*
+ * makes room for needed more bytes at the write offset; the records already
+ * read back are dropped by moving the unread ones to the start of the file
+ * when they take no more space than the consumed prefix, otherwise the file
+ * is remapped larger
+ */
+static bool ensure_mapped(spill_queue_t *queue, size_t needed) {
+    size_t unread = queue->write_offset - queue->read_offset;
+
+    if (queue->write_offset + needed > queue->map_size && queue->read_offset > 0 && queue->read_offset >= unread) {
+        memmove(queue->map, queue->map + queue->read_offset, unread);
+        queue->read_offset = 0;
+        queue->write_offset = unread;
+    }
+
+    needed += queue->write_offset;
+    if (needed <= queue->map_size) {
+        return true;
+    }
+
+    size_t new_size = queue->map_size * 2;
+    if (new_size < SPILL_CHUNK) {
+        new_size = SPILL_CHUNK;
+    }
+    while (new_size < needed) {
+        new_size *= 2;
+    }
+
+    if (ftruncate(queue->fd, (off_t) new_size) != 0) {
+        return false;
+    }
+
+    char *map = (char *) mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, queue->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    if (queue->map != NULL) {
+        munmap(queue->map, queue->map_size);
+    }
+
+    queue->map = map;
+    queue->map_size = new_size;
+
+    return true;
+}
+
+static bool spill(spill_queue_t *queue, void *data) {
+    size_t payload = queue->ops->size(data);
+    size_t size = record_size(payload);
+
+    if (!ensure_mapped(queue, size)) {
+        return false;
+    }
+
+    char *record = queue->map + queue->write_offset;
+    ((record_header_t *) record)->size = payload;
+    queue->ops->serialize(data, record + sizeof(record_header_t));
+
+    queue->write_offset += size;
+    queue->spilled += 1;
+
+    if (queue->ops->release != NULL) {
+        queue->ops->release(data);
+    }
+
+    return true;
+}
+
+/* moves up to count oldest items of the ring to the spill file, returns how many were moved */
+static int spill_oldest(spill_queue_t *queue, int count) {
+    int moved = 0;
+
+    while (moved < count && queue->size > 0 && spill(queue, queue->ring[queue->head])) {
+        queue->head = (queue->head + 1) & (queue->ring_capacity - 1);
+        queue->size -= 1;
+        moved += 1;
+    }
+
+    return moved;
+}
+
+/* reads the oldest spilled item back, it stays on disk if it cannot be rebuilt */
+static void* unspill(spill_queue_t *queue) {
+    char *record = queue->map + queue->read_offset;
+    size_t payload = ((record_header_t *) record)->size;
+
+    void *data = queue->ops->deserialize(record + sizeof(record_header_t), payload);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    queue->read_offset += record_size(payload);
+    queue->spilled -= 1;
+
+    if (queue->spilled == 0) {
+        // everything has been read back, start appending from the beginning again
+        queue->read_offset = 0;
+        queue->write_offset = 0;
+    }
+
+    return data;
+}
+
+spill_queue_t* create_spill_queue(int capacity, const char *path, const spill_ops_t *ops) {
+    if (capacity <= 0 || path == NULL || ops == NULL) {
+        return NULL;
+    }
+
+    spill_queue_t *queue = (spill_queue_t *) malloc(sizeof(spill_queue_t));
+    if (!queue) {
+        return NULL;
+    }
+
+    int ring_capacity = 1;
+    while (ring_capacity < capacity) {
+        ring_capacity *= 2;
+    }
+
+    queue->ring = (void **) malloc(sizeof(void *) * ring_capacity);
+    queue->path = (char *) malloc(strlen(path) + 1);
+    queue->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (!queue->ring || !queue->path || queue->fd < 0) {
+        if (queue->fd >= 0) {
+            close(queue->fd);
+            unlink(path);
+        }
+        free(queue->path);
+        free(queue->ring);
+        free(queue);
+        return NULL;
+    }
+
+    strcpy(queue->path, path);
+    queue->ring_capacity = ring_capacity;
+    queue->head = 0;
+    queue->size = 0;
+    queue->ops = ops;
+    queue->map = NULL;
+    queue->map_size = 0;
+    queue->write_offset = 0;
+    queue->read_offset = 0;
+    queue->spilled = 0;
+
+    return queue;
+}
+
+void delete_spill_queue(spill_queue_t *queue) {
+    if (queue != NULL) {
+        if (queue->map != NULL) {
+            munmap(queue->map, queue->map_size);
+        }
+
+        close(queue->fd);
+        unlink(queue->path);
+
+        free(queue->path);
+        free(queue->ring);
+        free(queue);
+    }
+}
+
+bool push_to_spill_queue(spill_queue_t *queue, void *data) {
+    // the oldest half of a full ring goes to disk, behind the items spilled before it
+    if (queue->size == queue->ring_capacity
+        && spill_oldest(queue, queue->ring_capacity > 1 ? queue->ring_capacity / 2 : 1) == 0) {
+        return false;
+    }
+
+    queue->ring[(queue->head + queue->size) & (queue->ring_capacity - 1)] = data;
+    queue->size += 1;
+
+    return true;
+}
+
+void* pop_from_spill_queue(spill_queue_t *queue) {
+    // everything on disk is older than the items in the ring
+    if (queue->spilled > 0) {
+        return unspill(queue);
+    }
+
+    if (queue->size == 0) {
+        return NULL;
+    }
+
+    void *data = queue->ring[queue->head];
+    queue->head = (queue->head + 1) & (queue->ring_capacity - 1);
+    queue->size -= 1;
+
+    return data;
+}
+
+long get_spill_queue_size(spill_queue_t *queue) {
+    return queue->size + queue->spilled;
+}
+
+long get_spilled_count(spill_queue_t *queue) {
+    return queue->spilled;
+}
@@ -0,0 +1,72 @@
+#ifndef __SPILL_QUEUE_H__
+#define __SPILL_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* callbacks turning queued items into bytes and back */
+typedef struct {
+    /* size of the serialized item in bytes */
+    size_t (*size)(const void *item);
+    /* writes the serialized item into dst, which holds size(item) bytes */
+    void (*serialize)(const void *item, void *dst);
+    /* rebuilds an item from its serialized form, NULL on failure */
+    void* (*deserialize)(const void *src, size_t size);
+    /* releases an item once it has been written to disk, may be NULL */
+    void (*release)(void *item);
+} spill_ops_t;
+
+/*
+ * FIFO queue with a bounded in-memory ring. Once the ring is full, its
+ * oldest half is serialized and appended to a memory-mapped spill file, so
+ * the file always holds the oldest items; pop reads them back sequentially
+ * before turning to the ring. Space of the records already read back is
+ * reused instead of growing the file. While nothing is spilled, push and
+ * pop touch only the ring.
+ */
+typedef struct {
+    void **ring;
+    int ring_capacity;
+    int head;
+    int size;
+
+    const spill_ops_t *ops;
+    char *path;
+    int fd;
+    char *map;
+    size_t map_size;
+    size_t write_offset;
+    size_t read_offset;
+    long spilled;
+} spill_queue_t;
+
+/*
+ * creates a new queue keeping up to capacity items in memory (rounded up
+ * to a power of two) and spilling the rest into the file at path
+ */
+spill_queue_t* create_spill_queue(int capacity, const char *path, const spill_ops_t *ops);
+
+/* deletes the queue, its spill file and all allocated memory */
+void delete_spill_queue(spill_queue_t *queue);
+
+/*
+ * inserts the element into the queue
+ * returns: true on success; false if the ring is full and none of its items
+ * could be spilled
+ */
+bool push_to_spill_queue(spill_queue_t *queue, void *data);
+
+/*
+ * gets the first element from the queue and removes it from the queue
+ * returns: the first element on success; NULL if the queue is empty or the
+ * first element could not be read back from disk, it then stays queued
+ */
+void* pop_from_spill_queue(spill_queue_t *queue);
+
+/* gets number of stored elements, both in memory and on disk */
+long get_spill_queue_size(spill_queue_t *queue);
+
+/* gets number of elements currently stored on disk */
+long get_spilled_count(spill_queue_t *queue);
+
+#endif /* __SPILL_QUEUE_H__ */
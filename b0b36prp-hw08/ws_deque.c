@@ -0,0 +1,161 @@
+#include "ws_deque.h"
+
+#define INIT_CAPACITY 64
+
+static ws_array_t* create_array(long capacity) {
+    ws_array_t *array = (ws_array_t *) malloc(sizeof(ws_array_t));
+    if (!array) {
+        return NULL;
+    }
+
+    array->items = (void **) malloc(sizeof(void *) * capacity);
+    if (!array->items) {
+        free(array);
+        return NULL;
+    }
+
+    array->capacity = capacity;
+    array->prev = NULL;
+
+    return array;
+}
+
+static inline void* array_get(ws_array_t *array, long i) {
+    return __atomic_load_n(&array->items[i & (array->capacity - 1)], __ATOMIC_RELAXED);
+}
+
+static inline void array_put(ws_array_t *array, long i, void *data) {
+    __atomic_store_n(&array->items[i & (array->capacity - 1)], data, __ATOMIC_RELAXED);
+}
+
+/*
+ * doubles the array; thieves may still read from the old one, so it is
+ * chained to the new array and freed only together with the deque
+ */
+static ws_array_t* grow_array(ws_deque_t *deque, ws_array_t *old, long top, long bottom) {
+    ws_array_t *array = create_array(old->capacity * 2);
+    if (!array) {
+        return NULL;
+    }
+
+    for (long i = top; i < bottom; ++i) {
+        array_put(array, i, array_get(old, i));
+    }
+
+    array->prev = old;
+    __atomic_store_n(&deque->array, array, __ATOMIC_RELEASE);
+
+    return array;
+}
+
+ws_deque_t* create_ws_deque(long capacity) {
+    ws_deque_t *deque = (ws_deque_t *) malloc(sizeof(ws_deque_t));
+    if (!deque) {
+        return NULL;
+    }
+
+    long array_capacity = INIT_CAPACITY;
+    while (array_capacity < capacity) {
+        array_capacity *= 2;
+    }
+
+    deque->array = create_array(array_capacity);
+    if (!deque->array) {
+        free(deque);
+        return NULL;
+    }
+
+    deque->top = 0;
+    deque->bottom = 0;
+
+    return deque;
+}
+
+void delete_ws_deque(ws_deque_t *deque) {
+    if (deque != NULL) {
+        ws_array_t *array = deque->array;
+
+        while (array != NULL) {
+            ws_array_t *prev = array->prev;
+            free(array->items);
+            free(array);
+            array = prev;
+        }
+
+        free(deque);
+    }
+}
+
+bool ws_push(ws_deque_t *deque, void *data) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    ws_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+
+    if (bottom - top > array->capacity - 1) {
+        array = grow_array(deque, array, top, bottom);
+        if (!array) {
+            return false;
+        }
+    }
+
+    array_put(array, bottom, data);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return true;
+}
+
+void* ws_pop(ws_deque_t *deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    ws_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    void *data = NULL;
+
+    if (top <= bottom) {
+        data = array_get(array, bottom);
+
+        if (top == bottom) {
+            // last element, race against thieves for it
+            if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                data = NULL;
+            }
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+
+    } else {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return data;
+}
+
+void* ws_steal(ws_deque_t *deque) {
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    ws_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_ACQUIRE);
+    void *data = array_get(array, top);
+
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    return data;
+}
+
+long get_ws_deque_size(ws_deque_t *deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    return bottom > top ? bottom - top : 0;
+}
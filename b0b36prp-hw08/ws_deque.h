@@ -0,0 +1,58 @@
+#ifndef __WS_DEQUE_H__
+#define __WS_DEQUE_H__
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* assumed cache line size, used to keep top and bottom apart */
+#define WS_CACHE_LINE 64
+
+/* circular array backing the deque, replaced arrays are kept until deletion */
+typedef struct ws_array {
+    long capacity;
+    void **items;
+    struct ws_array *prev;
+} ws_array_t;
+
+/*
+ * Chase-Lev work-stealing deque. The owner thread pushes and pops at the
+ * bottom, any other thread may steal from the top. Memory orderings follow
+ * Le, Pop, Cohen, Zappa Nardelli: "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" (PPoPP 2013).
+ */
+typedef struct {
+    long top;
+    char pad_top[WS_CACHE_LINE - sizeof(long)];
+    long bottom;
+    char pad_bottom[WS_CACHE_LINE - sizeof(long)];
+    ws_array_t *array;
+} ws_deque_t;
+
+/* creates a new deque with a given initial capacity (rounded up to a power of two) */
+ws_deque_t* create_ws_deque(long capacity);
+
+/* deletes the deque and all arrays it has ever used */
+void delete_ws_deque(ws_deque_t *deque);
+
+/*
+ * inserts the element at the bottom, owner thread only
+ * returns: true on success; false if the array could not grow
+ */
+bool ws_push(ws_deque_t *deque, void *data);
+
+/*
+ * removes the element at the bottom, owner thread only
+ * returns: the element; NULL if the deque is empty
+ */
+void* ws_pop(ws_deque_t *deque);
+
+/*
+ * removes the element at the top, any thread
+ * returns: the element; NULL if the deque is empty or another thread won the race
+ */
+void* ws_steal(ws_deque_t *deque);
+
+/* gets an estimate of the number of stored elements */
+long get_ws_deque_size(ws_deque_t *deque);
+
+#endif /* __WS_DEQUE_H__ */